@@ -0,0 +1,103 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <folly/Range.h>
+
+namespace iterlib {
+
+/**
+ * Monotonic allocator for memory that lives as long as an iterator: rows,
+ * row bytes and container nodes that are only ever added to. Allocating
+ * bumps a pointer, nothing is freed before the arena is destroyed, when
+ * all of it is released at once.
+ *
+ * dynamic values don't use it: their containers, strings and boxed
+ * alternatives always come from the global allocator, since the
+ * allocator is part of their public types.
+ *
+ * Blocks double in size up to kMaxBlockSize, larger requests get a block
+ * of their own. Not thread safe.
+ */
+class Arena {
+ public:
+  static constexpr size_t kMinBlockSize = 4096;
+  static constexpr size_t kMaxBlockSize = 1 << 20;
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    auto pos = (reinterpret_cast<uintptr_t>(pos_) + align - 1) & ~(align - 1);
+    if (pos + size > reinterpret_cast<uintptr_t>(end_)) {
+      return allocateSlow(size, align);
+    }
+    pos_ = reinterpret_cast<char*>(pos + size);
+    used_ += size;
+    return reinterpret_cast<void*>(pos);
+  }
+
+  // A copy of s that stays valid as long as the arena
+  folly::StringPiece copy(folly::StringPiece s);
+
+  // Bytes handed out by allocate()
+  size_t bytesUsed() const { return used_; }
+
+  // Bytes allocated from the system, including unused space
+  size_t bytesReserved() const { return reserved_; }
+
+ private:
+  void* allocateSlow(size_t size, size_t align);
+
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char* pos_{nullptr};
+  char* end_{nullptr};
+  size_t nextBlockSize_{kMinBlockSize};
+  size_t used_{0};
+  size_t reserved_{0};
+};
+
+// Standard allocator over an Arena. deallocate() is a no-op, so this suits
+// containers that grow until they are destroyed.
+template <typename T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(Arena* arena) : arena_(arena) {}
+
+  template <typename U>
+  /* implicit */ ArenaAllocator(const ArenaAllocator<U>& other)
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, size_t) {}
+
+  Arena* arena() const { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.arena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const {
+    return arena_ != other.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+
+}
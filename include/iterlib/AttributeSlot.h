@@ -0,0 +1,97 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <folly/Range.h>
+
+#include "iterlib/Item.h"
+
+namespace iterlib {
+
+/**
+ * Resolves one attribute of a row without materializing a dynamic.
+ *
+ * :id and :time come straight from the Item. Other attributes are looked up
+ * in the row's map. For vector_pair_t rows the position of the key is cached
+ * for the last few key vectors seen, rows produced by the same projection
+ * share one, so the lookup is a pointer compare instead of a scan of the
+ * keys. A cached position is trusted as is, so a key vector must not be
+ * freed and replaced by another one while the slot is in use. For renaming
+ * views the name the attribute has in the viewed row is cached per rename
+ * list the same way.
+ */
+class AttributeSlot {
+ public:
+  enum class Kind { MISSING = 0, INT, DOUBLE, STRING, OTHER };
+
+  // A borrowed view of the attribute value of the current row
+  struct Value {
+    Kind kind;
+    int64_t i;
+    double d;
+    folly::StringPiece s;
+    // Set for every kind except MISSING and the :id/:time attributes
+    const dynamic* dyn;
+  };
+
+  explicit AttributeSlot(const std::string& name);
+
+  const std::string& name() const { return name_; }
+
+  bool isIdOrTime() const { return source_ != Source::ATTRIBUTE; }
+
+  bool isId() const { return source_ == Source::ID; }
+
+  bool isTime() const { return source_ == Source::TIME; }
+
+  Value get(const Item& item);
+
+  // The attribute in a map row, nullptr if missing. Unlike get() this
+  // doesn't special case :id and :time.
+  const dynamic* find(const dynamic& row);
+
+  static Kind kindOf(const dynamic& v);
+
+  // Fills the scalar fields of out from v
+  static void classify(const dynamic& v, Value* out);
+
+ private:
+  enum class Source { ID, TIME, ATTRIBUTE };
+
+  static constexpr size_t kMissing = static_cast<size_t>(-1);
+
+  struct CachedKeys {
+    const std::vector<std::string>* keys;
+    // kMissing if the attribute isn't one of the keys
+    size_t index;
+  };
+
+  // The position of the attribute in keys, kMissing if it isn't there
+  size_t lookupIndex(const std::vector<std::string>* keys);
+
+  std::string name_;
+  dynamic key_;
+  Source source_;
+  // Enough for rows from a few projections to alternate, e.g. in a sort
+  std::array<CachedKeys, 4> cachedKeys_{};
+  size_t nextCached_{0};
+  // Set when this attribute has another name in the target of a view
+  const variant::rename_vec_t* cachedRenames_{nullptr};
+  std::shared_ptr<AttributeSlot> renamedSlot_;
+  bool hidden_{false};
+};
+
+// partialCompare() over columns resolved once into slots, so that each
+// comparison looks attributes up by cached index instead of by name
+PartialOrder partialCompare(const Item& v1, const Item& v2,
+                            std::vector<AttributeSlot>& columns,
+                            const std::vector<bool>& isColumnDescending);
+
+}
@@ -0,0 +1,53 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#pragma once
+
+namespace iterlib {
+namespace detail {
+
+template <typename T>
+void CountDistinctIterator<T>::addRow(const T& row) {
+  if (mergeSketches_) {
+    const auto* v = attribute_.empty() ? &row.value()
+                                       : slot_.find(row.value());
+    if (v == nullptr) {
+      return;
+    } else if (v->template is_of<std::string>()) {
+      sketch_.merge(
+          HyperLogLog::deserialize(v->template getRef<std::string>()));
+    } else if (v->template is_of<folly::StringPiece>()) {
+      sketch_.merge(
+          HyperLogLog::deserialize(v->template get<folly::StringPiece>()));
+    }
+    return;
+  }
+  uint64_t hash;
+  if (HyperLogLog::hashAttribute(row, &slot_, &hash)) {
+    sketch_.add(hash);
+  }
+}
+
+template <typename T>
+bool CountDistinctIterator<T>::doNext() {
+  if (this->done() || counted_) {
+    this->setDone();
+    return false;
+  }
+
+  while (this->innerIter_->next()) {
+    addRow(this->innerIter_->value());
+  }
+  counted_ = true;
+  if (emitSketch_) {
+    countValue_ = sketch_.serialize();
+  } else {
+    countValue_ = sketch_.estimate();
+  }
+  return true;
+}
+
+}
+}
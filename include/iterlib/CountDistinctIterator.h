@@ -0,0 +1,75 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include "iterlib/HyperLogLog.h"
+#include "iterlib/WrappedIterator.h"
+
+namespace iterlib {
+namespace detail {
+
+// Approximate count of the distinct values of attribute in iter, or of
+// distinct ids if attribute is empty. Memory use is bounded by the sketch
+// size regardless of the number of rows.
+//
+// To combine results from several shards, have each shard emit its sketch
+// with setEmitSketch(true) and feed them (e.g. through a FutureIterator) to
+// a CountDistinctIterator with setMergeSketches(true).
+template <typename T=Item>
+class CountDistinctIterator : public WrappedIterator<T> {
+public:
+  explicit CountDistinctIterator(
+      Iterator<T>* iter, std::string attribute = "",
+      uint8_t precision = HyperLogLog::kDefaultPrecision)
+    : WrappedIterator<T>(iter)
+    , attribute_(std::move(attribute))
+    , slot_(attribute_.empty() ? kIdKey : attribute_)
+    , sketch_(precision)
+    , countValue_(-1) {
+  }
+
+  virtual const T& key() const override {
+    return kCountDistinctKey;
+  }
+
+  // The estimate as int64_t, or the serialized sketch if setEmitSketch()
+  virtual const T& value() const override {
+    return countValue_;
+  }
+
+  const HyperLogLog& sketch() const { return sketch_; }
+
+  // Emit the serialized sketch as a string instead of the estimate
+  void setEmitSketch(bool emitSketch) { emitSketch_ = emitSketch; }
+
+  // Treat attribute of each input row (or the whole row, if attribute is
+  // empty) as a serialized sketch and merge it, instead of hashing values.
+  void setMergeSketches(bool mergeSketches) { mergeSketches_ = mergeSketches; }
+
+  static const T kCountDistinctKey;
+
+protected:
+  bool doNext() override;
+
+private:
+  void addRow(const T& row);
+
+  std::string attribute_;
+  // attribute_ resolved once for the per row lookups
+  AttributeSlot slot_;
+  HyperLogLog sketch_;
+  bool emitSketch_ = false;
+  bool mergeSketches_ = false;
+  bool counted_ = false;
+  mutable T countValue_;
+};
+
+}
+
+using CountDistinctIterator = detail::CountDistinctIterator<Item>;
+
+}
+
+#include "iterlib/CountDistinctIterator-inl.h"
@@ -8,20 +8,48 @@
 namespace iterlib {
 namespace detail {
 
+template <typename T>
+int64_t CountIterator<T>::countExact() {
+  // Pull one past the cap to tell "exactly cap" from "more than cap"
+  const size_t limit = (cap_ == kNoCap) ? kNoCap : cap_ + 1;
+  int64_t count = this->innerIter_->countRemaining(limit);
+  if (count < 0) {
+    count = 0;
+    while (static_cast<size_t>(count) < limit && this->innerIter_->next()) {
+      count++;
+    }
+  }
+  if (static_cast<size_t>(count) > cap_) {
+    truncated_ = true;
+    count = cap_;
+  }
+  return count;
+}
+
 template <typename T>
 bool CountIterator<T>::doNext() {
+  // countValue_ starts out as -1, so this also stops after an empty count
   auto count = countValue_.template get<int64_t>();
-  if (this->done() || count > 0) {
+  if (this->done() || count >= 0) {
+    this->setDone();
     return false;
   }
 
-  count = 0;
-  while (this->innerIter_->next()) {
-    count++;
+  if (mode_ == CountMode::ESTIMATE) {
+    count = this->innerIter_->estimateRemaining();
+    if (count >= 0 && (cap_ == kNoCap || static_cast<size_t>(count) > cap_)) {
+      estimated_ = true;
+      countValue_ = count;
+      return true;
+    }
   }
-  countValue_ = count;
+
+  countValue_ = countExact();
   return true;
 }
 
+template <typename T>
+constexpr size_t CountIterator<T>::kNoCap;
+
 }
 }
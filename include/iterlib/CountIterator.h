@@ -3,15 +3,32 @@
 #include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
+
+enum class CountMode {
+  EXACT = 0,
+  // Prefer the child's estimateRemaining() when it has one. Counts that
+  // fall under the cap are still exact.
+  ESTIMATE,
+};
+
 namespace detail {
 
 // count the number of items in iter
+//
+// With a cap, stops pulling from iter after cap items; truncated() then
+// tells that the count is "cap or more".
 template <typename T=Item>
 class CountIterator : public WrappedIterator<T> {
 public:
-  explicit CountIterator(Iterator<T>* iter)
+  static constexpr size_t kNoCap = std::numeric_limits<size_t>::max();
+
+  explicit CountIterator(Iterator<T>* iter,
+                         size_t cap = kNoCap,
+                         CountMode mode = CountMode::EXACT)
     : WrappedIterator<T>(iter)
-    , countValue_(-1) {
+    , countValue_(-1)
+    , cap_(cap)
+    , mode_(mode) {
   }
 
   virtual const T& key() const override {
@@ -22,13 +39,25 @@ public:
     return countValue_;
   }
 
+  // True if counting stopped at the cap
+  bool truncated() const { return truncated_; }
+
+  // True if value() is an estimate
+  bool estimated() const { return estimated_; }
+
   static const T kCountKey;
 
 protected:
   bool doNext() override;
 
 private:
+  int64_t countExact();
+
   mutable T countValue_;
+  size_t cap_;
+  CountMode mode_;
+  bool truncated_ = false;
+  bool estimated_ = false;
 };
 
 }
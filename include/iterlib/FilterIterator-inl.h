@@ -8,8 +8,6 @@
 namespace iterlib {
 namespace detail {
 
-using variant::vector_dynamic_t;
-
 template <typename T>
 bool FilterIteratorBase<T>::doNext() {
   while (this->innerIter_->next()) {
@@ -47,81 +45,67 @@ bool FilterIteratorBase<T>::doSkipTo(id_t id) {
 }
 
 template <typename T>
-bool FilterIterator<T>::match(const Iterator<T>* iter) {
-  dynamic v;
-  auto& values = reinterpret_cast<std::vector<dynamic>&>(
-      values_.getNonConstRef<vector_dynamic_t>());
-  if (fields_.is_of<std::string>()) {
-    if (fields_ == dynamic(kIdKey)) {
-      v = static_cast<int64_t>(iter->id());
-    } else if (fields_ == dynamic(kTimeKey)) {
-      v = iter->value().ts();
-    } else {
-      v = iter->value().atNoThrow(fields_);
-      if (firstTime_ && !v.empty()) {
-        // Try to learn the type of the attribute
-        firstTime_ = false;
-        for (auto& val : values) {
-          val.castTo(v);
-        }
-      }
+folly::Future<folly::Unit> FilterIterator<T>::prepare() {
+  if (!this->prepared_) {
+    for (auto* inner = foldableInner(); inner != nullptr;
+         inner = foldableInner()) {
+      // The inner filter sees rows first, keep its predicate first
+      predicate_ = Predicate::makeAnd(std::move(inner->predicate_),
+                                      std::move(predicate_));
+      this->innerIter_ = std::move(inner->innerIter_);
     }
-  } else {
-    auto vec = vector_dynamic_t();
-    for (const auto& field : fields_) {
-      if (dynamic(field.second.get()) == kIdKey) {
-        vec.emplace_back(static_cast<int64_t>(iter->id()));
-      } else if (dynamic(field.second.get()) == kTimeKey) {
-        vec.emplace_back(iter->value().ts());
-      } else {
-        vec.push_back(iter->value().atNoThrow(field.second.get()));
-      }
+    if (predicate_ && !this->innerIter_->prepared()) {
+      pushDownRanges();
+    }
+    if (hasColumns_ && !this->innerIter_->prepared()) {
+      pushDownColumns();
     }
-    v = std::move(vec);
   }
+  return FilterIteratorBase<T>::prepare();
+}
 
-  const dynamic& rhs = values.size() > 1 ? values_ : values[0];
-  switch (filterType_) {
-  case FilterType::GE:
-    return v >= rhs;
-  case FilterType::GT:
-    return v > rhs;
-  case FilterType::LE:
-    return v <= rhs;
-  case FilterType::LT:
-    return v < rhs;
-  case FilterType::RANGE:
-    return v >= values.at(0) && v <= values.at(1);
-  case FilterType::EQ:
-    return std::find(values.begin(), values.end(), v) != values.end();
-  case FilterType::NE:
-    return (v != rhs);
-  case FilterType::PREFIX:
-    try {
-      folly::StringPiece sp = v.is_of<folly::StringPiece>()
-                                  ? v.get<folly::StringPiece>()
-                                  : v.getRef<std::string>();
-      return sp.startsWith(rhs.get<std::string>());
-    } catch (const std::exception& e) {
-      LOG(ERROR) << "Failed to compare by prefix: " << e.what();
-      return false;
-    }
-  case FilterType::CONTAINS:
-    try {
-      folly::StringPiece sp = v.is_of<folly::StringPiece>()
-                                  ? v.get<folly::StringPiece>()
-                                  : v.getRef<std::string>();
-      return sp.contains(rhs.get<std::string>());
-    } catch (const std::exception& e) {
-      LOG(ERROR) << "StringPiece contains exception: " << e.what();
-      return false;
+template <typename T>
+FilterIterator<T>* FilterIterator<T>::foldableInner() const {
+  // Subclasses may override match(), so only plain filters are folded
+  if (typeid(*this) != typeid(FilterIterator<T>)) {
+    return nullptr;
+  }
+  auto* inner = this->innerIter_.get();
+  if (typeid(*inner) != typeid(FilterIterator<T>)) {
+    return nullptr;
+  }
+  auto* filter = static_cast<FilterIterator<T>*>(inner);
+  return filter->prepared() ? nullptr : filter;
+}
+
+template <typename T>
+void FilterIterator<T>::pushDownRanges() {
+  for (const auto& attribute : {kTimeKey, kIdKey}) {
+    int64_t min = std::numeric_limits<int64_t>::min();
+    int64_t max = std::numeric_limits<int64_t>::max();
+    predicate_->narrowRange(attribute, &min, &max);
+    if (min != std::numeric_limits<int64_t>::min() ||
+        max != std::numeric_limits<int64_t>::max()) {
+      this->innerIter_->pushDownRange(attribute, min, max);
     }
-  case FilterType::INSET:
-    return std::find(values.begin(), values.end(), v) != values.end();
-  default:
-    return false;
   }
 }
 
+template <typename T>
+void FilterIterator<T>::pushDownColumns() {
+  auto needed = columns_;
+  // Rows keep all their attributes if the predicate can't list the ones
+  // it reads
+  if (!predicate_ || predicate_->addAttributes(&needed)) {
+    this->innerIter_->setRequiredColumns(needed);
+  }
+}
+
+template <typename T>
+bool FilterIterator<T>::match(const Iterator<T>* iter) {
+  // No filter set lets everything through
+  return !predicate_ || predicate_->match(iter->value());
+}
+
 }
 }
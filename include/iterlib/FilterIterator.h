@@ -1,25 +1,12 @@
 #pragma once
 
+#include <typeinfo>
+
+#include "iterlib/Predicate.h"
 #include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
 
-enum class FilterType {
-  INVALID = 0,
-  GE,
-  GT,
-  LE,
-  LT,
-  EQ,
-  NE,
-  EXISTS,
-  PREFIX,
-  CONTAINS,
-  // These types can take more than one argument
-  RANGE,
-  INSET,
-};
-
 namespace detail {
 
 template <typename T=Item>
@@ -29,73 +16,94 @@ class FilterIteratorBase : public WrappedIterator<T> {
 
   bool orderPreserving() const override { return true; }
 
+  bool stableValues() const override {
+    return this->innerIter_->stableValues();
+  }
+
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    return this->innerIter_->saveCursor(cursor, rewind);
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    return this->innerIter_->restoreCursor(cursor);
+  }
+
+  // Dropping rows keeps the order of the others
+  bool pushDownReverse() override {
+    return this->innerIter_->pushDownReverse();
+  }
+
+  bool cacheable() const override { return this->innerIter_->cacheable(); }
+
  protected:
   bool doNext() override;
 
   bool doSkipTo(id_t id) override;
 
+  bool doReset() override { return this->innerIter_->reset(); }
+
   virtual bool match(const Iterator<T>* iter) = 0;
 };
 
 template <typename T=Item>
 class FilterIterator : public FilterIteratorBase<T> {
  public:
-  explicit FilterIterator(Iterator<T>* iter)
-      : FilterIteratorBase<T>(iter), firstTime_(true) {}
-
+  explicit FilterIterator(Iterator<T>* iter) : FilterIteratorBase<T>(iter) {}
+
+  // Replaces the filter with a single comparison
+  //
+  // We support FilterType operators with:
+  //  1 field, 1 value
+  //  1 field, n values (RANGE, EQ and INSET)
+  //  n fields, n values: tuple comparison, or a set of n-tuples for EQ
+  //    and INSET
+  // Throws std::invalid_argument for other combinations.
   void setFilter(const std::vector<std::string>& fields,
                  const std::vector<dynamic>& values, FilterType filterType) {
-    if (fields.size() == 1) {
-      fields_ = fields[0];
-    } else {
-      auto fieldVec = variant::vector_dynamic_t();
-      for (const auto& v : fields) {
-        fieldVec.emplace_back(v);
-      }
-      fields_ = std::move(fieldVec);
-    }
-
-    // We support FilterType operators with:
-    //  1 field, 1 value
-    //  1 field, n values
-    // and some combination of the two
-    //
-    // TODO: Better detection of incorrect arity of field/values
-    // Eg: (filter (= (a  b) (1 2 3)))
-    auto valueVec = variant::vector_dynamic_t();
-    int i = 0;
-    for (const auto& value : values) {
-      // Use other type information for attributes
-      // that are ints
-      if ((i < fields.size()) &&
-          (fields[i] == kIdKey || (fields[i] == kTimeKey))) {
-        int64_t intVal;
-        if (value.is_of<int64_t>()) {
-          intVal = value.get<int64_t>();
-        } else {
-          intVal = folly::to<int64_t>(value.toString());
-        }
-        valueVec.emplace_back(intVal);
-      } else {
-        valueVec.push_back(value);
-      }
-      i++;
-    }
-    values_ = std::move(valueVec);
-    filterType_ = filterType;
+    predicate_ = Predicate::compile(fields, values, filterType);
+  }
+
+  // ANDs another comparison to the filter
+  void addFilter(const std::vector<std::string>& fields,
+                 const std::vector<dynamic>& values, FilterType filterType) {
+    predicate_ = Predicate::makeAnd(
+        std::move(predicate_), Predicate::compile(fields, values, filterType));
+  }
+
+  // For arbitrary AND/OR/NOT expressions, see Predicate
+  void setPredicate(std::unique_ptr<Predicate> predicate) {
+    predicate_ = std::move(predicate);
+  }
+
+  // Folds unprepared FilterIterators directly below this one into its
+  // predicate, so a chain of filters costs one virtual call per row, and
+  // offers the bounds the predicate implies on :time and :id to the
+  // inner iterator, see Iterator::pushDownRange(). Folded filters are
+  // destroyed, pointers to them must not be used after prepare().
+  // Subclasses of FilterIterator are neither folded nor fold others.
+  virtual folly::Future<folly::Unit> prepare() override;
+
+  // The columns, plus the attributes the filter reads, are pushed down in
+  // prepare() once the filter is final
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    columns_ = columns;
+    hasColumns_ = true;
+    return true;
   }
 
  protected:
   virtual bool match(const Iterator<T>* iter) override;
 
  private:
-  // filter information
-  dynamic fields_;
-  dynamic values_;
-
-  bool firstTime_;
-
-  FilterType filterType_;
+  // The unprepared FilterIterator directly below this one if both are
+  // exactly FilterIterator<T>, otherwise null
+  FilterIterator<T>* foldableInner() const;
+  void pushDownRanges();
+  void pushDownColumns();
+
+  std::unique_ptr<Predicate> predicate_;
+  AttributeNameVec columns_;
+  bool hasColumns_{false};
 };
 
 }
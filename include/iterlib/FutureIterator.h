@@ -4,6 +4,8 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 #pragma once
 
+#include <functional>
+
 #include "iterlib/Iterator.h"
 
 namespace iterlib {
@@ -17,20 +19,50 @@ namespace detail {
  */
 template <typename T = Item> class FutureIterator : public iterlib::Iterator {
  public:
+  // Starts the fetch of the rows, columns is null when all attributes
+  // are needed
+  using Fetch = std::function<folly::Future<std::vector<T>>(
+      const AttributeNameVec* columns)>;
+
   explicit FutureIterator(folly::Future<std::vector<T>>&& f,
                           Item key = Item::kEmptyItem)
       : iterlib::Iterator(IteratorType::FUTURE), idx_(0), fResult_(std::move(f)) {
     this->key_ = key;
   }
 
+  // For data sources that can fetch a subset of the attributes. The fetch
+  // is deferred to prepare() so setRequiredColumns() can narrow it.
+  explicit FutureIterator(Fetch fetch, Item key = Item::kEmptyItem)
+      : iterlib::Iterator(IteratorType::FUTURE),
+        idx_(0),
+        fetch_(std::move(fetch)),
+        fResult_(folly::makeFuture(std::vector<T>())) {
+    this->key_ = key;
+  }
+
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    if (!fetch_) {
+      return false;
+    }
+    columns_ = columns;
+    hasColumns_ = true;
+    return true;
+  }
+
   folly::Future<folly::Unit> prepare() override final {
     if (this->prepared_) {
       return folly::makeFuture();
     }
+    if (fetch_) {
+      fResult_ = fetch_(hasColumns_ ? &columns_ : nullptr);
+      fetch_ = nullptr;
+    }
 
     return fResult_
         .then([this](const std::vector<T>& res) {
-          result_ = res;
+          // Rows before a restored cursor are never returned
+          start_ = std::min(start_, res.size());
+          result_.assign(res.begin() + start_, res.end());
           this->prepared_ = true;
         })
         .onError([](const std::exception& ex) {
@@ -39,6 +71,25 @@ template <typename T = Item> class FutureIterator : public iterlib::Iterator {
         });
   }
 
+  bool stableValues() const override { return true; }
+
+  bool cacheable() const override { return true; }
+
+  // The cursor is the index of the next row in the fetched vector
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    auto next = start_ + idx_;
+    if (rewind && this->hasCurrent()) {
+      next--;
+    }
+    *cursor = static_cast<int64_t>(next);
+    return true;
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    start_ = this->cursorIndex(cursor);
+    return true;
+  }
+
   virtual const T& value() const override {
     if (idx_ != 0) {
       return result_[idx_ - 1];
@@ -57,6 +108,40 @@ template <typename T = Item> class FutureIterator : public iterlib::Iterator {
     return true;
   }
 
+  bool doSkip(size_t n) override final {
+    if (this->done()) {
+      return false;
+    }
+    if (n > result_.size() - idx_) {
+      idx_ = result_.size();
+      this->setDone();
+      return false;
+    }
+    idx_ += n;
+    return true;
+  }
+
+  bool doReset() override {
+    idx_ = 0;
+    return true;
+  }
+
+  ssize_t countRemaining(size_t limit) override {
+    if (this->done()) {
+      return 0;
+    }
+    auto n = std::min(limit, result_.size() - idx_);
+    idx_ += n;
+    if (idx_ == result_.size()) {
+      this->setDone();
+    }
+    return n;
+  }
+
+  ssize_t estimateRemaining() const override {
+    return this->done() ? 0 : result_.size() - idx_;
+  }
+
   void setOrderCols(AttributeNameVec orderByColumns,
                     std::vector<bool> isDescending) {
     orderByColumns_ = std::move(orderByColumns);
@@ -70,9 +155,14 @@ template <typename T = Item> class FutureIterator : public iterlib::Iterator {
  private:
   size_t idx_;
   std::vector<T> result_;
+  // Index in the fetched vector of result_[0]
+  size_t start_{0};
   AttributeNameVec orderByColumns_;
   std::vector<bool> isDescending_;
 
+  Fetch fetch_;
+  AttributeNameVec columns_;
+  bool hasColumns_{false};
   folly::Future<std::vector<T>> fResult_;
 };
 
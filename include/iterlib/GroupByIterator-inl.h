@@ -5,19 +5,33 @@
 
 #pragma once
 
+#include <stdexcept>
+
 namespace iterlib {
 namespace detail {
 
+// The values of the grouped by attributes of row. Throws std::out_of_range
+// when one is missing, as dynamic::at() does.
+inline dynamic groupByKey(const dynamic& row,
+                          std::vector<AttributeSlot>& slots) {
+  auto key = std::vector<dynamic>{};
+  key.reserve(slots.size());
+  for (auto& slot : slots) {
+    const dynamic* v = slot.find(row);
+    if (v == nullptr) {
+      throw std::out_of_range("Key not found: " + slot.name());
+    }
+    key.push_back(*v);
+  }
+  return dynamic(std::move(key));
+}
+
 template <typename T>
 void GroupByIterator<T>::groupBy() {
 
   while (this->innerIter_->next()) {
     const auto& v = this->innerIter_->value();
-    auto key = std::vector<dynamic>{};
-    for (const auto& attr : groupByAttributes_) {
-      key.push_back(v.at(attr.second.get()));
-    }
-    T itemKey{dynamic(std::move(key))};
+    T itemKey{groupByKey(v, groupBySlots_)};
     results_[itemKey].emplace_back(&v);
   }
   iter_ = results_.begin();
@@ -46,11 +60,7 @@ template <typename T>
 void GroupBySortedCountIterator<T>::groupBy() {
   while (this->innerIter_->next()) {
     const auto& v = this->innerIter_->value();
-    auto key = std::vector<dynamic>{};
-    for (const auto& attr : groupByAttributes_) {
-      key.push_back(v.at(attr.second.get()));
-    }
-    Item itemKey{dynamic(std::move(key))};
+    Item itemKey{groupByKey(v, groupBySlots_)};
     if (results_.find(itemKey) != results_.end()) {
       auto& count = results_[itemKey].template getNonConstRef<int64_t>();
       count++;
@@ -80,5 +90,43 @@ bool GroupBySortedCountIterator<T>::doNext() {
   return true;
 }
 
+template <typename T>
+void GroupByCountDistinctIterator<T>::groupBy() {
+  while (this->innerIter_->next()) {
+    const auto& v = this->innerIter_->value();
+    uint64_t hash;
+    if (!HyperLogLog::hashAttribute(v, &distinctSlot_, &hash)) {
+      continue;
+    }
+    T itemKey{groupByKey(v, groupBySlots_)};
+    auto it = results_.find(itemKey);
+    if (it == results_.end()) {
+      it = results_.emplace(std::move(itemKey), HyperLogLog(precision_)).first;
+    }
+    it->second.add(hash);
+  }
+  iter_ = results_.begin();
+}
+
+// On first call to doNext() it will run the groupby algorithm.
+template <typename T>
+bool GroupByCountDistinctIterator<T>::doNext() {
+  if (this->done()) {
+    return false;
+  }
+  if (!resultsGroupedBy) {
+    groupBy();
+    resultsGroupedBy = true;
+  } else {
+    iter_++;
+  }
+  if (iter_ == results_.end()) {
+    this->setDone();
+    return false;
+  }
+  countValue_ = iter_->second.estimate();
+  return true;
+}
+
 }
 }
@@ -2,19 +2,32 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
+
+#include "iterlib/Arena.h"
+#include "iterlib/AttributeSlot.h"
+#include "iterlib/HyperLogLog.h"
 #include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
 namespace detail {
 
+// Groups are only added until the iterator is destroyed, so the nodes come
+// from an arena the iterator owns. It is on the heap so that moving the
+// iterator doesn't move it from under the map.
+template <typename K, typename V, typename Compare = std::less<K>>
+using GroupMap =
+    std::map<K, V, Compare, ArenaAllocator<std::pair<const K, V>>>;
+
 template <typename T=Item>
 class GroupByIterator : public WrappedIterator<T> {
  public:
   explicit GroupByIterator(Iterator<T>* iter, AttributeNameVec groupByAttributes)
-      : WrappedIterator<T>(iter), groupByAttributes_(variant::vector_dynamic_t()) {
-    auto& vec = groupByAttributes_.template getNonConstRef<variant::vector_dynamic_t>();
-    vec.insert(vec.begin(), std::make_move_iterator(groupByAttributes.begin()),
-               std::make_move_iterator(groupByAttributes.end()));
+      : WrappedIterator<T>(iter) {
+    for (const auto& attr : groupByAttributes) {
+      groupBySlots_.emplace_back(attr);
+    }
   }
 
   virtual const T& key() const override { return iter_->first; }
@@ -39,11 +52,12 @@ class GroupByIterator : public WrappedIterator<T> {
   // valid.
   bool resultsGroupedBy = false;
   // Attributes the iterator is grouping by
-  T groupByAttributes_;
+  std::vector<AttributeSlot> groupBySlots_;
 
   // Results of groupBy()
-  using MapType = std::map<T, std::vector<const T*>>;
-  MapType results_;
+  using MapType = GroupMap<T, std::vector<const T*>>;
+  std::unique_ptr<Arena> arena_{new Arena()};
+  MapType results_{typename MapType::allocator_type(arena_.get())};
   typename MapType::iterator iter_;
 };
 
@@ -54,10 +68,10 @@ class GroupBySortedCountIterator : public WrappedIterator<T> {
  public:
   explicit GroupBySortedCountIterator(Iterator<T>* iter,
                                       AttributeNameVec groupByAttributes)
-      : WrappedIterator<T>(iter), groupByAttributes_(variant::vector_dynamic_t()) {
-    auto& vec = groupByAttributes_.template getNonConstRef<variant::vector_dynamic_t>();
-    vec.insert(vec.begin(), std::make_move_iterator(groupByAttributes.begin()),
-               std::make_move_iterator(groupByAttributes.end()));
+      : WrappedIterator<T>(iter) {
+    for (const auto& attr : groupByAttributes) {
+      groupBySlots_.emplace_back(attr);
+    }
   }
 
   virtual const T& key() const override { return iter_->first; }
@@ -76,18 +90,72 @@ class GroupBySortedCountIterator : public WrappedIterator<T> {
   // valid.
   bool resultsGroupedBy = false;
   // Attributes the iterator is grouping by
-  T groupByAttributes_;
+  std::vector<AttributeSlot> groupBySlots_;
+
+  // Results of groupBy()
+  using MapType = GroupMap<T, T, std::greater<T>>;
+  std::unique_ptr<Arena> arena_{new Arena()};
+  MapType results_{typename MapType::allocator_type(arena_.get())};
+  typename MapType::iterator iter_;
+};
+
+// Similar to GroupByIterator, but returns the approximate number of distinct
+// values of distinctAttribute (or of distinct ids, if empty) in each group.
+// Input doesn't need to be sorted.
+template <typename T=Item>
+class GroupByCountDistinctIterator : public WrappedIterator<T> {
+ public:
+  explicit GroupByCountDistinctIterator(
+      Iterator<T>* iter, AttributeNameVec groupByAttributes,
+      std::string distinctAttribute = "",
+      uint8_t precision = HyperLogLog::kDefaultPrecision)
+      : WrappedIterator<T>(iter),
+        distinctAttribute_(std::move(distinctAttribute)),
+        distinctSlot_(distinctAttribute_.empty() ? kIdKey
+                                                 : distinctAttribute_),
+        precision_(precision) {
+    for (const auto& attr : groupByAttributes) {
+      groupBySlots_.emplace_back(attr);
+    }
+  }
+
+  virtual const T& key() const override { return iter_->first; }
+
+  const T& value() const override { return countValue_; }
+
+  // Sketch of the current group, e.g. to merge with other shards
+  const HyperLogLog& sketch() const { return iter_->second; }
+
+ protected:
+  // Runs the actual group by algorithm and fill results_ attribute
+  void groupBy();
+
+  // On first call to doNext() it will run the groupby algorithm.
+  bool doNext() override final;
+
+ private:
+  // Flag used for lazy computing groupby results. If true, then results_ is
+  // valid.
+  bool resultsGroupedBy = false;
+  // Attributes the iterator is grouping by
+  std::vector<AttributeSlot> groupBySlots_;
+  std::string distinctAttribute_;
+  AttributeSlot distinctSlot_;
+  uint8_t precision_;
 
   // Results of groupBy()
-  using MapType = std::map<T, T, std::greater<T>>;
-  MapType results_;
+  using MapType = GroupMap<T, HyperLogLog>;
+  std::unique_ptr<Arena> arena_{new Arena()};
+  MapType results_{typename MapType::allocator_type(arena_.get())};
   typename MapType::iterator iter_;
+  T countValue_;
 };
 
 }
 
 using GroupByIterator = detail::GroupByIterator<Item>;
 using GroupBySortedCountIterator = detail::GroupBySortedCountIterator<Item>;
+using GroupByCountDistinctIterator = detail::GroupByCountDistinctIterator<Item>;
 
 }
 
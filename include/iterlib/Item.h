@@ -46,7 +46,7 @@ class Item : public dynamic {
 
   virtual id_t id() const {
     try {
-      return at(kIdKey).get<int64_t>();
+      return attribute(kIdKey).get<int64_t>();
     } catch (const std::exception& ex) {
       LOG_EVERY_N(WARNING, 1000) << ex.what();
       return kUninitializedId;
@@ -55,7 +55,7 @@ class Item : public dynamic {
 
   virtual int64_t ts() const {
     try {
-      return at(kTimeKey).get<int64_t>();
+      return attribute(kTimeKey).get<int64_t>();
     } catch (const std::exception& ex) {
       LOG_EVERY_N(WARNING, 1000) << ex.what();
       return 0;
@@ -63,6 +63,16 @@ class Item : public dynamic {
   }
 
   const dynamic& value() const { return *this; }
+
+ protected:
+  // Throws std::out_of_range if the attribute is missing
+  const dynamic& attribute(folly::StringPiece key) const {
+    const dynamic* v = find(key);
+    if (v == nullptr) {
+      throw std::out_of_range("Key not found: " + key.str());
+    }
+    return *v;
+  }
 };
 
 // Provides O(1) access to id() and ts(). Otherwise identical to
@@ -101,8 +111,8 @@ class ItemOptimized : public Item {
 
   void syncIdTs() {
     try {
-      id_ = at(kIdKey).get<int64_t>();
-      ts_ = at(kTimeKey).get<int64_t>();
+      id_ = attribute(kIdKey).get<int64_t>();
+      ts_ = attribute(kTimeKey).get<int64_t>();
     } catch (const std::exception& ex) {
       LOG_EVERY_N(WARNING, 1000) << ex.what();
     }
@@ -32,6 +32,24 @@ bool Iterator<T>::next() {
   return ret;
 }
 
+template <typename T>
+const variant::vector_dynamic_t& Iterator<T>::cursorFields(
+    const dynamic& cursor, size_t size) {
+  if (!cursor.is_of<variant::vector_dynamic_t>() || cursor.size() != size) {
+    throw std::invalid_argument(
+        folly::stringPrintf("Expected a cursor of %zu fields", size));
+  }
+  return cursor.getRef<variant::vector_dynamic_t>();
+}
+
+template <typename T>
+size_t Iterator<T>::cursorIndex(const dynamic& cursor) {
+  if (!cursor.is_of<int64_t>() || cursor.get<int64_t>() < 0) {
+    throw std::invalid_argument("Expected a non negative cursor index");
+  }
+  return cursor.get<int64_t>();
+}
+
 template <typename T>
 bool Iterator<T>::doSkip(size_t n) {
   while (n > 0 && next()) {
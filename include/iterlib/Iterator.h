@@ -54,6 +54,7 @@ enum class IteratorType : int32_t {
   FUTURE,
   ORDERBY,
   BINARY,
+  SPOOL,
 };
 
 enum class ResultOrder {
@@ -82,7 +83,7 @@ class IteratorTraits {
   //
   // a) The iterator has a bounded number of entries, that are accessible
   //    cheaply.
-  // b) The iterator can be rewound after reading the end.
+  // b) The iterator can be rewound with reset() after reading the end.
   virtual bool cacheable() const { return false; }
 
   virtual ResultOrder order() const { return order_; }
@@ -99,6 +100,12 @@ class IteratorTraits {
   // zero to hint to higher level iterators for optimization purposes.
   virtual ssize_t numBuffered() const { return -1; }
 
+  // True if references returned by value() remain valid and unchanged
+  // until the iterator is destroyed, rather than only until it advances.
+  // Iterators wrapping such a child may point into its values instead of
+  // copying them.
+  virtual bool stableValues() const { return false; }
+
  protected:
   // Order guaranteed by the iterator. May not be same as the underlying
   // index
@@ -174,15 +181,75 @@ class Iterator
     return ret;
   }
 
+  // Counts up to limit of the items next() would still return and
+  // advances past them, without materializing value(). Returns -1, with no
+  // side effects, if the iterator can't do this more cheaply than calling
+  // next() repeatedly; callers then fall back to iterating.
+  //
+  // value() and key() are unspecified after a successful call.
+  virtual ssize_t countRemaining(
+      size_t limit = std::numeric_limits<size_t>::max()) {
+    return -1;
+  }
+
+  // Cheap approximation of the number of items next() would still
+  // return, eg: from index statistics. Has no side effects. Returns -1 if
+  // no estimate is available.
+  virtual ssize_t estimateRemaining() const { return -1; }
+
+  // Tells an unprepared iterator that the caller discards every row whose
+  // integer attribute (:id or :time) is outside [min, max]. Returns true
+  // if the iterator narrowed its scan accordingly. It may still return
+  // rows outside the bounds, callers have to keep filtering.
+  virtual bool pushDownRange(const std::string& attribute, int64_t min,
+                             int64_t max) {
+    return false;
+  }
+
+  // Moves a prepared iterator to a row picked at random, roughly
+  // uniformly, among all the rows of its scan, eg: by seeking. Returns
+  // false if the iterator can't do this cheaply or has no rows. next()
+  // continues from the picked row.
+  virtual bool seekRandom() { return false; }
+
+  // Asks an unprepared iterator to return its rows in reverse order.
+  // Returns true if it will, eg: by scanning its source backward.
+  virtual bool pushDownReverse() { return false; }
+
+  // Tells an unprepared iterator that the caller only reads the given
+  // attributes of its rows. Returns true if the iterator will only decode
+  // (or fetch) those, other attributes may then be missing from its rows.
+  // A later call replaces the columns of an earlier one.
+  virtual bool setRequiredColumns(const AttributeNameVec& columns) {
+    return false;
+  }
+
+  // Describes where iteration stands, so that a new, unprepared tree of
+  // the same shape can resume from there with restoreCursor(), eg: to
+  // fetch the next page after a roundtrip to the client. Leaves record
+  // their position in their source and operators add their own state,
+  // such as the rows left to a limit. Resuming then costs a seek per
+  // leaf rather than a rescan of the pages already returned.
+  //
+  // The cursor is made of integers, strings and arrays of them, so it
+  // survives a toJson() round trip. With rewind, the resumed tree
+  // returns the current row again. Returns false if some iterator in
+  // the tree doesn't support cursors.
+  virtual bool saveCursor(dynamic* cursor, bool rewind = false) const {
+    return false;
+  }
+
+  // Positions an unprepared iterator at a cursor from saveCursor().
+  // Returns false if some iterator in the tree doesn't support cursors,
+  // and throws std::invalid_argument if the cursor doesn't fit the tree.
+  // Either way the tree should then be discarded.
+  virtual bool restoreCursor(const dynamic& cursor) { return false; }
+
   virtual IteratorType getType() const { return iteratorType_; }
 
   // Return an opaque cookie that could be used to resume
-  // iteration after a roundtrip to the client. This is about
-  // as efficient as doing an optimizied skipToPredicate()
-  //
-  // Potential implementation strategy: concatenate cookies
-  // from all leaf iterators and perform Seek() or skipToPredicate()
-  // on all of them before resuming execution.
+  // iteration after a roundtrip to the client. Trees that support
+  // saveCursor() resume more efficiently from that.
   //
   // For complex iterator trees, a less optimal, but more general
   // implementation is below. Such cookies can be resumed via:
@@ -196,7 +263,19 @@ class Iterator
     return folly::stringPrintf("%ld,%lu", value().ts(), id());
   }
 
-  virtual void reset() { isDone_ = false; }
+  // Rewinds a prepared iterator, next() then returns its rows again
+  // from the first one (or from the cursor it was restored at), eg: for
+  // the inner side of a nested loop. Returns false, leaving the iterator
+  // as it was, if it can't rewind without rebuilding its tree. Wrap such
+  // subtrees in a MaterializeIterator.
+  bool reset() {
+    if (!doReset()) {
+      return false;
+    }
+    isDone_ = false;
+    advancedAtleastOnce_ = false;
+    return true;
+  }
 
   virtual const IteratorVector<T>& children() const {
     static const IteratorVector<T> kEmptyVec;
@@ -212,9 +291,20 @@ class Iterator
   virtual bool doSkipToPredicate(AttributeNameVec predicate,
                                  const T& target);
   virtual bool doSkip(size_t n);
+  // Rewinds the iterator's own state, see reset()
+  virtual bool doReset() { return false; }
 
   void setDone() { isDone_ = true; }
 
+  // Whether value() is a row returned by next()
+  bool hasCurrent() const { return advancedAtleastOnce_ && !isDone_; }
+
+  // For restoreCursor(), throw std::invalid_argument if cursor is not an
+  // array of size values or a non negative integer respectively
+  static const variant::vector_dynamic_t& cursorFields(const dynamic& cursor,
+                                                       size_t size);
+  static size_t cursorIndex(const dynamic& cursor);
+
   void throwIfUnPrepared() const {
     if (UNLIKELY(!prepared_)) {
       throw std::logic_error("called without calling prepare() first");
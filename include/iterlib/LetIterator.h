@@ -8,6 +8,13 @@
 namespace iterlib {
 namespace detail {
 
+// Renames the attribute oldKey to newKey.
+//
+// When the child's values stay valid (stableValues()) the result is a
+// dynamic_ref aliasing the child's row, so a row costs no copy and no
+// allocation. Views coming out of a let below are flattened into one view
+// of their target with the combined renames, so chains of lets stay O(1)
+// per row too. Other children are copied into a renamed ordered_map_t.
 template <typename T=Item>
 class LetIterator : public WrappedIterator<T> {
  public:
@@ -16,16 +23,26 @@ class LetIterator : public WrappedIterator<T> {
                        dynamic oldKey)
       : WrappedIterator<T>(inner)
       , newKey_(std::move(newKey))
-      , oldKey_(std::move(oldKey)) {}
+      , oldKey_(std::move(oldKey))
+      , renames_{{oldKey_, newKey_}}
+      , syncIdTs_(newKey_ == dynamic(kIdKey) ||
+                  newKey_ == dynamic(kTimeKey)) {}
 
   const T& value() const override {
     const auto& item = this->innerIter_->value();
-    auto omap = item.asRenamedMap(oldKey_, newKey_);
-    value_.reset();
-    value_.setId(item.id());
-    value_.setTs(item.ts());
-    value_ = std::move(omap);
-    value_.syncIdTs();
+    if (item.template is_of<variant::dynamic_ref>()) {
+      const auto& ref = item.template getRef<variant::dynamic_ref>();
+      setView(item, variant::dynamic_ref{ref.target, combine(ref.renames)});
+    } else if (this->innerIter_->stableValues()) {
+      setView(item, variant::dynamic_ref{&item.value(), &renames_});
+    } else {
+      auto omap = item.asRenamedMap(oldKey_, newKey_);
+      value_.reset();
+      value_.setId(item.id());
+      value_.setTs(item.ts());
+      value_ = std::move(omap);
+      value_.syncIdTs();
+    }
     return value_;
   }
 
@@ -33,12 +50,97 @@ class LetIterator : public WrappedIterator<T> {
     return this->innerIter_->next();
   }
 
+  // Views are only built by value(), so skipped rows cost nothing here
+  bool doSkip(size_t n) override {
+    if (!this->innerIter_->skip(n)) {
+      this->setDone();
+      return false;
+    }
+    return true;
+  }
+
+  bool doReset() override { return this->innerIter_->reset(); }
+
   virtual bool orderPreserving() const { return true; }
 
+  ssize_t countRemaining(size_t limit) override {
+    return this->innerIter_->countRemaining(limit);
+  }
+
+  ssize_t estimateRemaining() const override {
+    return this->innerIter_->estimateRemaining();
+  }
+
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    return this->innerIter_->saveCursor(cursor, rewind);
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    return this->innerIter_->restoreCursor(cursor);
+  }
+
+  bool pushDownReverse() override {
+    return this->innerIter_->pushDownReverse();
+  }
+
+  bool seekRandom() override { return this->innerIter_->seekRandom(); }
+
+  // newKey is read from the child as oldKey, which the child's rows no
+  // longer have under its own name
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    const auto oldName = oldKey_.toString();
+    const auto newName = newKey_.toString();
+    AttributeNameVec needed;
+    for (const auto& column : columns) {
+      if (column != oldName && column != newName) {
+        needed.push_back(column);
+      }
+    }
+    needed.push_back(oldName);
+    return this->innerIter_->setRequiredColumns(needed);
+  }
+
+  bool cacheable() const override { return this->innerIter_->cacheable(); }
+
  protected:
+  void setView(const T& item, variant::dynamic_ref ref) const {
+    value_.setId(item.id());
+    value_.setTs(item.ts());
+    value_ = dynamic(ref);
+    if (syncIdTs_) {
+      const auto* id = value_.find(kIdKey);
+      if (id != nullptr && id->is_of<int64_t>()) {
+        value_.setId(id->get<int64_t>());
+      }
+      const auto* ts = value_.find(kTimeKey);
+      if (ts != nullptr && ts->is_of<int64_t>()) {
+        value_.setTs(ts->get<int64_t>());
+      }
+    }
+  }
+
+  // The renames of a view from a let below followed by ours. Those don't
+  // change while the let below exists, so they are only combined once.
+  const variant::rename_vec_t* combine(
+      const variant::rename_vec_t* inner) const {
+    if (inner == nullptr) {
+      return &renames_;
+    }
+    if (inner != combinedFrom_) {
+      combined_ = *inner;
+      combined_.insert(combined_.end(), renames_.begin(), renames_.end());
+      combinedFrom_ = inner;
+    }
+    return &combined_;
+  }
 
   dynamic newKey_;
   dynamic oldKey_;
+  const variant::rename_vec_t renames_;
+  // Whether the renamed attribute overrides the id or the timestamp
+  const bool syncIdTs_;
+  mutable const variant::rename_vec_t* combinedFrom_{nullptr};
+  mutable variant::rename_vec_t combined_;
   // TODO: revisit the contract that all references returned
   // from the iterator need to be valid even after next().
   // Do we want to modify the item in-place instead of making
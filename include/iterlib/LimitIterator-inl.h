@@ -34,5 +34,94 @@ bool LimitIterator<T>::doNext() {
   return ret;
 }
 
+template <typename T>
+ssize_t LimitIterator<T>::countRemaining(size_t limit) {
+  if (this->done()) {
+    return 0;
+  }
+  limit = std::min(limit, count_);
+  if (firstTime_ && startOffset_ > 0) {
+    auto skipped = this->innerIter_->countRemaining(startOffset_);
+    if (skipped < 0) {
+      return -1;
+    }
+    firstTime_ = false;
+    if (static_cast<size_t>(skipped) < startOffset_) {
+      this->setDone();
+      return 0;
+    }
+  }
+
+  auto count = this->innerIter_->countRemaining(limit);
+  if (count < 0) {
+    // The offset was already consumed, so count the rest by hand
+    count = 0;
+    while (static_cast<size_t>(count) < limit && this->innerIter_->next()) {
+      count++;
+    }
+  }
+  count_ -= count;
+  if (count_ == 0 || static_cast<size_t>(count) < limit) {
+    this->setDone();
+  }
+  return count;
+}
+
+template <typename T>
+bool LimitIterator<T>::saveCursor(dynamic* cursor, bool rewind) const {
+  // The current row was counted
+  rewind = rewind && this->hasCurrent();
+  dynamic inner;
+  if (!this->innerIter_->saveCursor(&inner, rewind)) {
+    return false;
+  }
+  *cursor = variant::vector_dynamic_t{
+      static_cast<int64_t>(count_ + (rewind ? 1 : 0)),
+      static_cast<int64_t>(firstTime_ ? startOffset_ : 0),
+      std::move(inner)};
+  return true;
+}
+
+template <typename T>
+bool LimitIterator<T>::restoreCursor(const dynamic& cursor) {
+  const auto& fields = this->cursorFields(cursor, 3);
+  count_ = initialCount_ = this->cursorIndex(fields[0]);
+  startOffset_ = initialOffset_ = this->cursorIndex(fields[1]);
+  firstTime_ = true;
+  return this->innerIter_->restoreCursor(fields[2]);
+}
+
+template <typename T>
+bool LimitIterator<T>::doReset() {
+  if (!this->innerIter_->reset()) {
+    return false;
+  }
+  count_ = initialCount_;
+  startOffset_ = initialOffset_;
+  firstTime_ = true;
+  return true;
+}
+
+template <typename T>
+ssize_t LimitIterator<T>::estimateRemaining() const {
+  if (this->done()) {
+    return 0;
+  }
+  auto estimate = this->innerIter_->estimateRemaining();
+  if (estimate < 0) {
+    return -1;
+  }
+  if (firstTime_) {
+    // The offset can be larger than the estimate, or than any ssize_t
+    const size_t remaining = static_cast<size_t>(estimate);
+    estimate = remaining > startOffset_
+        ? static_cast<ssize_t>(remaining - startOffset_)
+        : 0;
+  }
+  return static_cast<size_t>(estimate) < count_
+      ? estimate
+      : static_cast<ssize_t>(count_);
+}
+
 }
 }
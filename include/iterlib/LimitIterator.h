@@ -17,20 +17,45 @@ class LimitIterator : public WrappedIterator<T> {
  public:
   LimitIterator(Iterator<T>* iter, size_t count, size_t startOffset)
       : WrappedIterator<T>(iter), count_(count), startOffset_(startOffset),
-        firstTime_(true) {}
+        firstTime_(true), initialCount_(count),
+        initialOffset_(startOffset) {}
 
   std::string cookie() const override { return this->innerIter_->cookie(); }
 
   virtual bool orderPreserving() const override { return true; }
 
+  bool stableValues() const override {
+    return this->innerIter_->stableValues();
+  }
+
+  bool cacheable() const override { return this->innerIter_->cacheable(); }
+
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    return this->innerIter_->setRequiredColumns(columns);
+  }
+
+  ssize_t countRemaining(size_t limit) override;
+
+  // The cursor is [rows left, offset left, inner cursor]
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override;
+
+  bool restoreCursor(const dynamic& cursor) override;
+
+  ssize_t estimateRemaining() const override;
+
  protected:
   bool doNext() override;
 
+  bool doReset() override;
+
  private:
   size_t count_;
   size_t startOffset_;
 
   bool firstTime_;
+  // count_ and startOffset_ before the first row, for reset()
+  size_t initialCount_;
+  size_t initialOffset_;
 };
 
 }
@@ -0,0 +1,79 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#pragma once
+
+namespace iterlib {
+namespace detail {
+
+template <typename T>
+bool MaterializeIterator<T>::doNext() {
+  if (pos_ < rows_.size()) {
+    current_ = rows_[pos_++];
+    return true;
+  }
+  current_ = nullptr;
+  // A replay that reaches the end of a partial cache continues with the
+  // child, which is positioned right after the cached rows
+  if (complete_ || !this->innerIter_->next()) {
+    complete_ = caching_;
+    this->setDone();
+    return false;
+  }
+  if (caching_) {
+    cache();
+  }
+  return true;
+}
+
+template <typename T>
+void MaterializeIterator<T>::cache() {
+  const T& row = this->innerIter_->value();
+  if (this->innerIter_->stableValues()) {
+    rows_.push_back(&row);
+  } else {
+    copies_.push_back(row);
+    rows_.push_back(&copies_.back());
+    bytes_ += sizeof(T) - sizeof(dynamic) + row.memoryUsage();
+  }
+  bytes_ += sizeof(const T*);
+  if (bytes_ > maxBytes_) {
+    VLOG(1) << "MaterializeIterator cache exceeds " << maxBytes_ << " bytes";
+    caching_ = false;
+    rows_ = std::vector<const T*>();
+    copies_.clear();
+    bytes_ = 0;
+    pos_ = 0;
+    return;
+  }
+  pos_ = rows_.size();
+  current_ = rows_.back();
+}
+
+template <typename T>
+bool MaterializeIterator<T>::doReset() {
+  if (!caching_) {
+    return this->innerIter_->reset();
+  }
+  pos_ = 0;
+  current_ = nullptr;
+  return true;
+}
+
+template <typename T>
+ssize_t MaterializeIterator<T>::estimateRemaining() const {
+  if (this->done()) {
+    return 0;
+  }
+  const ssize_t cached = rows_.size() - pos_;
+  if (complete_) {
+    return cached;
+  }
+  const ssize_t rest = this->innerIter_->estimateRemaining();
+  return rest < 0 ? -1 : cached + rest;
+}
+
+}
+}
@@ -0,0 +1,83 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <deque>
+#include <vector>
+
+#include "iterlib/WrappedIterator.h"
+
+namespace iterlib {
+namespace detail {
+
+/**
+ * Caches the rows of its child so that reset() replays them instead of
+ * running the child again, eg: for the inner side of a nested loop.
+ *
+ * Rows are cached as the child returns them, by pointer when its values
+ * are stable and as copies otherwise. Once the cache takes more than
+ * maxBytes it is dropped, and later passes rewind the child itself with
+ * reset(), which fails if the child can't. Children that are already
+ * cacheable() are rewound directly and never cached.
+ */
+template <typename T=Item>
+class MaterializeIterator : public WrappedIterator<T> {
+ public:
+  MaterializeIterator(Iterator<T>* iter, size_t maxBytes)
+      : WrappedIterator<T>(iter),
+        maxBytes_(maxBytes),
+        caching_(!iter->cacheable()) {}
+
+  const T& value() const override {
+    return current_ ? *current_ : this->innerIter_->value();
+  }
+
+  virtual bool orderPreserving() const override { return true; }
+
+  // Until the cache outgrows maxBytes
+  bool cacheable() const override {
+    return caching_ || this->innerIter_->cacheable();
+  }
+
+  bool stableValues() const override {
+    return this->innerIter_->stableValues();
+  }
+
+  ssize_t estimateRemaining() const override;
+
+  // Memory taken by the cache
+  size_t cachedBytes() const { return bytes_; }
+
+ protected:
+  bool doNext() override;
+
+  bool doReset() override;
+
+ private:
+  // Adds the child's current row to the cache, or drops the cache if it
+  // gets too large
+  void cache();
+
+  const size_t maxBytes_;
+  bool caching_;
+  // Whether rows_ holds every row of the child
+  bool complete_{false};
+  std::vector<const T*> rows_;
+  // Backs rows_ when the child's values aren't stable
+  std::deque<T> copies_;
+  size_t bytes_{0};
+  // Index in rows_ of the next row to replay
+  size_t pos_{0};
+  // Current row, nullptr when it is the child's
+  const T* current_{nullptr};
+};
+
+}
+
+using MaterializeIterator = detail::MaterializeIterator<Item>;
+
+}
+
+#include "iterlib/MaterializeIterator-inl.h"
@@ -10,11 +10,15 @@ namespace detail {
 
 template <typename T>
 void MergeIterator<T>::storeData() {
-  value_ = this->activeChildren_.front()->value();
+  const auto* front = this->activeChildren_.front();
+  const auto& first = front->value();
+  value_ = static_cast<const dynamic&>(first);
+  value_.setId(first.id());
+  value_.setTs(first.ts());
   // This is where the actual merge happens
-  for (auto& child : this->activeChildren_) {
-    if (child != this->activeChildren_.front() && child->id() == this->id()) {
-      value_.merge(child->value());
+  for (const auto* child : this->activeChildren_) {
+    if (child != front && child->id() == value_.id()) {
+      merger_.merge(&value_, child->value());
     }
   }
 }
@@ -3,6 +3,7 @@
 #pragma once
 
 #include "iterlib/OrIterator.h"
+#include "iterlib/RowMerger.h"
 
 namespace iterlib {
 namespace detail {
@@ -10,9 +11,11 @@ namespace detail {
 // This performs an id() based merge of
 // items among the child iterators
 //
-// The actual merge algorithm for children
-// having the same id() is given by
-// dynamic::merge()
+// The values of children having the same id()
+// are merged attribute by attribute with a
+// RowMerger. By default attributes in several
+// children are combined like dynamic::merge()
+// does, other strategies can be set per attribute.
 template <typename T=Item>
 class MergeIterator : public UnionIterator<T> {
  public:
@@ -23,15 +26,27 @@ class MergeIterator : public UnionIterator<T> {
     return value_;
   }
 
+  void setMergeStrategy(const std::string& attribute,
+                        MergeStrategy strategy) {
+    merger_.setStrategy(attribute, strategy);
+  }
+
+  void setDefaultMergeStrategy(MergeStrategy strategy) {
+    merger_.setDefaultStrategy(strategy);
+  }
+
  protected:
   bool doNext() override {
     auto ret = UnionIterator<T>::doNext();
-    storeData();
+    if (ret) {
+      storeData();
+    }
     return ret;
   }
 
   void storeData();
 
+  RowMerger merger_;
   ItemOptimized value_;
 };
 
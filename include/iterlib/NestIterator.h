@@ -13,6 +13,10 @@ namespace detail {
 // If your inner iterator yields { "foo" : bar }
 // and your nest key is "baz", this iterator will
 // yield: { "baz" : { "foo" : bar } }
+//
+// The nested value is a dynamic_ref to the inner row when the inner
+// iterator has stableValues() (or yields views itself), otherwise a copy.
+// The outer map is built once and only its value is replaced per row.
 template <typename T=Item>
 class NestIterator : public WrappedIterator<T> {
  public:
@@ -23,18 +27,85 @@ class NestIterator : public WrappedIterator<T> {
   const T& value() const override {
     return value_;
   }
+
+  ssize_t countRemaining(size_t limit) override {
+    return this->innerIter_->countRemaining(limit);
+  }
+
+  ssize_t estimateRemaining() const override {
+    return this->innerIter_->estimateRemaining();
+  }
+
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    return this->innerIter_->saveCursor(cursor, rewind);
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    return this->innerIter_->restoreCursor(cursor);
+  }
+
+  bool pushDownReverse() override {
+    return this->innerIter_->pushDownReverse();
+  }
+
+  bool seekRandom() override {
+    if (!this->innerIter_->seekRandom()) {
+      return false;
+    }
+    storeData();
+    return true;
+  }
+
+  bool cacheable() const override { return this->innerIter_->cacheable(); }
+
+  // The nested row is read as a whole, the child can only skip attributes
+  // when the nest key isn't required. Its :id and :time are still read.
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    for (const auto& column : columns) {
+      if (key_ == dynamic(column)) {
+        return false;
+      }
+    }
+    return this->innerIter_->setRequiredColumns(columns);
+  }
+
  protected:
 
   bool doNext() override {
     auto ret = this->innerIter_->next();
-    storeData();
+    if (ret) {
+      storeData();
+    }
     return ret;
   }
 
+  // Only the row skipped to is nested
+  bool doSkip(size_t n) override {
+    if (!this->innerIter_->skip(n)) {
+      this->setDone();
+      return false;
+    }
+    storeData();
+    return true;
+  }
+
+  bool doReset() override { return this->innerIter_->reset(); }
+
   void storeData() {
     const auto& inner = this->innerIter_->value();
     const dynamic& val = inner;
-    value_ = variant::ordered_map_t{{ key_, val }};
+    if (!value_.is_of<variant::ordered_map_t>()) {
+      value_ = variant::ordered_map_t{{ key_, dynamic() }};
+    }
+    auto& nested = value_.getNonConstRef<variant::ordered_map_t>()
+                       .begin()->second;
+    if (val.is_of<variant::dynamic_ref>()) {
+      nested = val;
+    } else if (this->innerIter_->stableValues()) {
+      nested = variant::dynamic_ref{&val, nullptr};
+    } else {
+      nested = val;
+    }
     value_.setId(inner.id());
     value_.setTs(inner.ts());
   }
@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 namespace iterlib {
 namespace detail {
 
@@ -114,6 +116,43 @@ bool OrIterator<Comparator, T>::doSkipTo(id_t id) {
   return true;
 }
 
+template <class Comparator, typename T>
+bool OrIterator<Comparator, T>::saveCursor(dynamic* cursor,
+                                           bool rewind) const {
+  const bool started = !firstTime_ && this->hasCurrent();
+  const auto current = started ? this->id() : max();
+  variant::vector_dynamic_t cursors;
+  cursors.reserve(this->children().size());
+  for (const auto& child : this->children()) {
+    cursors.emplace_back();
+    if (!child) {
+      continue;
+    }
+    const bool active =
+        started && std::find(activeChildren_.begin(), activeChildren_.end(),
+                             child.get()) != activeChildren_.end();
+    // Rows of the other children have only been peeked at
+    if (!child->saveCursor(&cursors.back(),
+                           active && (rewind || child->id() != current))) {
+      return false;
+    }
+  }
+  *cursor = std::move(cursors);
+  return true;
+}
+
+template <class Comparator, typename T>
+bool OrIterator<Comparator, T>::restoreCursor(const dynamic& cursor) {
+  const auto& cursors = this->cursorFields(cursor, this->children().size());
+  for (size_t i = 0; i < cursors.size(); i++) {
+    const auto& child = this->children()[i];
+    if (child && !child->restoreCursor(cursors[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 template <typename T>
 ConcatIterator<T>::ConcatIterator(IteratorVector<T>& children,
                                   bool dedup)
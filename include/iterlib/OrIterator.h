@@ -33,6 +33,12 @@ class OrIterator: public OrIteratorBase<T> {
 public:
   explicit OrIterator(IteratorVector<T>& children);
 
+  // The cursor has one entry per child (null for missing ones). Children
+  // whose current row is waiting in the heap are saved rewound.
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override;
+
+  bool restoreCursor(const dynamic& cursor) override;
+
 protected:
   bool doNext() override;
   bool doSkipTo(id_t id) override;
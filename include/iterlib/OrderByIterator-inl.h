@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+
 #include "iterlib/OrderByIterator.h"
 
 namespace iterlib {
@@ -20,5 +23,45 @@ operator()(const std::pair<const T*, int>& v1,
          (cmp == PartialOrder::EQ && v1.second > v2.second);
 }
 
+template <typename T>
+bool OrderByIterator<T>::doSkip(size_t n) {
+  if (this->done() || n == 0) {
+    return !this->done();
+  }
+
+  // The first row returned is at the front, and isn't popped
+  if (first_) {
+    this->load();
+    first_ = false;
+    n--;
+  }
+  if (n >= results_.size()) {
+    results_.clear();
+    this->setDone();
+    return false;
+  }
+
+  Comparator cmp(orderBySlots_, isColumnDescending_);
+  // Popping costs log(size) per row, selecting the rows to drop and
+  // rebuilding the heap is linear in the size
+  if (n * std::log2(results_.size()) < results_.size()) {
+    for (; n > 0; n--) {
+      std::pop_heap(results_.begin(), results_.end(), cmp);
+      results_.pop_back();
+    }
+    return true;
+  }
+  // Moves the n rows that come first to the front. Ties are broken by
+  // sequence number, so these are exactly the rows pop_heap would drop.
+  std::nth_element(results_.begin(), results_.begin() + n, results_.end(),
+                   [&cmp](const std::pair<const T*, int>& v1,
+                          const std::pair<const T*, int>& v2) {
+                     return cmp(v2, v1);
+                   });
+  results_.erase(results_.begin(), results_.begin() + n);
+  std::make_heap(results_.begin(), results_.end(), cmp);
+  return true;
+}
+
 }
 }
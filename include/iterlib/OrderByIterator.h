@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "iterlib/AttributeSlot.h"
 #include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
@@ -15,6 +16,9 @@ class OrderByIterator : public WrappedIterator<T> {
       : WrappedIterator<T>(iter), orderByColumns_(std::move(orderByColumns)),
         isColumnDescending_(std::move(isColumnDescending)), first_(true) {
     CHECK_EQ(orderByColumns_.size(), isColumnDescending_.size());
+    for (const auto& column : orderByColumns_) {
+      orderBySlots_.emplace_back(column);
+    }
     if ((this->innerIter_ == nullptr) || (this->innerIter_->done())) {
       this->prepared_ = true;
       this->setDone();
@@ -29,13 +33,13 @@ class OrderByIterator : public WrappedIterator<T> {
   virtual ~OrderByIterator() {}
 
   struct Comparator {
-    Comparator(const AttributeNameVec& columns,
+    Comparator(std::vector<AttributeSlot>& columns,
                const std::vector<bool>& isColumnDescending)
         : columns_(columns), isColumnDescending_(isColumnDescending) {}
 
     // columns_ and isColumnDescending are of the same size, and
     // isColumnDescending_[i] indicates if columns_[i] is in descending order
-    const AttributeNameVec& columns_;
+    std::vector<AttributeSlot>& columns_;
     const std::vector<bool>& isColumnDescending_;
     bool operator()(const std::pair<const T*, int>& v1,
                     const std::pair<const T*, int>& v2) const;
@@ -59,7 +63,7 @@ class OrderByIterator : public WrappedIterator<T> {
       first_ = false;
     } else {
       std::pop_heap(results_.begin(), results_.end(),
-                    Comparator(orderByColumns_, isColumnDescending_));
+                    Comparator(orderBySlots_, isColumnDescending_));
       results_.pop_back();
     }
 
@@ -71,6 +75,9 @@ class OrderByIterator : public WrappedIterator<T> {
     return true;
   }
 
+  // Drops the skipped rows from the heap without ordering them
+  bool doSkip(size_t n) override;
+
   const AttributeNameVec& orderByColumns() const { return orderByColumns_; }
 
   const std::vector<bool>& isDescending() const { return isColumnDescending_; }
@@ -84,12 +91,14 @@ class OrderByIterator : public WrappedIterator<T> {
     }
 
     std::make_heap(results_.begin(), results_.end(),
-                   Comparator(orderByColumns_, isColumnDescending_));
+                   Comparator(orderBySlots_, isColumnDescending_));
   }
 
  private:
   std::vector<std::pair<const T*, int>> results_;
   AttributeNameVec orderByColumns_;
+  // orderByColumns_ resolved once, compared rows are looked up by index
+  std::vector<AttributeSlot> orderBySlots_;
   std::vector<bool> isColumnDescending_;
   bool first_;
 };
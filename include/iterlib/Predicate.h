@@ -0,0 +1,88 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "iterlib/AttributeSlot.h"
+#include "iterlib/Item.h"
+
+namespace iterlib {
+
+enum class FilterType {
+  INVALID = 0,
+  GE,
+  GT,
+  LE,
+  LT,
+  EQ,
+  NE,
+  EXISTS,
+  PREFIX,
+  CONTAINS,
+  // These types can take more than one argument
+  RANGE,
+  INSET,
+};
+
+/**
+ * A boolean expression over the attributes of a row.
+ *
+ * Leaves are built by compile() from the same (fields, values, FilterType)
+ * triple FilterIterator::setFilter() accepts, and can be combined with
+ * makeAnd(), makeOr() and makeNot(). Leaves learn the type of their
+ * attribute from the first row that has it, string constants are converted
+ * to that type once, after which rows are compared as plain int64_t, double
+ * or StringPiece. Rows whose attribute is missing or can't be compared with
+ * the constant don't match (except for NE, which matches them).
+ *
+ * match() is not const because of that type learning, a Predicate must not
+ * be shared between iterators.
+ */
+class Predicate {
+ public:
+  virtual ~Predicate() {}
+
+  virtual bool match(const Item& item) = 0;
+
+  // Narrows the inclusive range [*min, *max] to the values of the integer
+  // attribute (usually :id or :time) that every matching row must have.
+  // Leaves it alone when the predicate doesn't bound the attribute, and
+  // may set *min > *max when nothing can match.
+  virtual void narrowRange(const std::string& attribute, int64_t* min,
+                           int64_t* max) const {}
+
+  // Appends the attributes match() reads to *attributes. Returns false if
+  // they aren't known, which is the default for predicates defined
+  // elsewhere.
+  virtual bool addAttributes(std::vector<std::string>* attributes) const {
+    return false;
+  }
+
+  // Throws std::invalid_argument if the combination of fields, values and
+  // filter type is not supported
+  static std::unique_ptr<Predicate> compile(
+      const std::vector<std::string>& fields,
+      const std::vector<dynamic>& values,
+      FilterType filterType);
+
+  // Children are evaluated in order and evaluation stops as soon as the
+  // result is known, so put the most selective ones first.
+  static std::unique_ptr<Predicate> makeAnd(
+      std::vector<std::unique_ptr<Predicate>> children);
+
+  static std::unique_ptr<Predicate> makeOr(
+      std::vector<std::unique_ptr<Predicate>> children);
+
+  static std::unique_ptr<Predicate> makeNot(std::unique_ptr<Predicate> child);
+
+  // Convenience for combining two predicates, either may be null
+  static std::unique_ptr<Predicate> makeAnd(std::unique_ptr<Predicate> a,
+                                            std::unique_ptr<Predicate> b);
+};
+
+}
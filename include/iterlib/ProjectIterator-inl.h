@@ -8,30 +8,65 @@
 namespace iterlib {
 namespace detail {
 
+using variant::vector_pair_t;
+
 template <typename T>
 bool ProjectIterator<T>::doNext() {
+  current_ = nullptr;
   return this->innerIter_->next();
 }
 
 template <typename T>
 const T& ProjectIterator<T>::value() const {
-  try {
-    const auto& item = this->innerIter_->value();
-    auto projection = item.asProjectedMap(attrNames_);
-    value_.reset();
-    value_.setId(item.id());
-    value_.setTs(item.ts());
-    value_ = std::move(projection);
-    value_.syncIdTs();
-    return value_;
-  } catch (std::exception& ex) {
-    LOG_EVERY_N(ERROR, 500) << ex.what();
-    return Item::kEmptyItem;
+  if (current_ == nullptr) {
+    current_ = project();
+  }
+  return *current_;
+}
+
+template <typename T>
+const T* ProjectIterator<T>::project() const {
+  const auto& item = this->innerIter_->value();
+  if (!item.isObject()) {
+    LOG_EVERY_N(ERROR, 500) << "Can't project, not a map type";
+    return &Item::kEmptyItem;
+  }
+
+  // Reuses the value vector of the previous row
+  if (!value_.is_of<vector_pair_t>()) {
+    value_ = vector_pair_t(&attrNames_, {});
+  }
+  auto& values = value_.getNonConstRef<vector_pair_t>().second;
+  values.resize(attrNames_.size());
+  const bool borrow = borrowStrings_ && this->innerIter_->stableValues();
+  value_.setId(item.id());
+  value_.setTs(item.ts());
+  for (size_t i = 0; i < slots_.size(); i++) {
+    const dynamic* v = slots_[i].find(item.value());
+    if (v == nullptr) {
+      values[i] = dynamic();
+      continue;
+    }
+    if (borrow && v->is_of<std::string>()) {
+      values[i] = folly::StringPiece(v->getRef<std::string>());
+    } else {
+      values[i] = *v;
+    }
+    // Projected :id and :time take precedence, like in syncIdTs()
+    if (v->is_of<int64_t>()) {
+      if (attrNames_[i] == kIdKey) {
+        value_.setId(v->get<int64_t>());
+      } else if (attrNames_[i] == kTimeKey) {
+        value_.setTs(v->get<int64_t>());
+      }
+    }
   }
+  return &value_;
 }
 
 template <typename T>
 bool ProjectIterator<T>::doSkipTo(id_t id) {
+  current_ = nullptr;
   if (!this->innerIter_->skipTo(id)) {
     this->setDone();
     return false;
@@ -39,5 +74,15 @@ bool ProjectIterator<T>::doSkipTo(id_t id) {
   return true;
 }
 
+template <typename T>
+bool ProjectIterator<T>::doSkip(size_t n) {
+  current_ = nullptr;
+  if (!this->innerIter_->skip(n)) {
+    this->setDone();
+    return false;
+  }
+  return true;
+}
+
 }
 }
@@ -1,6 +1,9 @@
 //  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
 #pragma once
 
+#include <algorithm>
+
+#include "iterlib/AttributeSlot.h"
 #include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
@@ -10,30 +13,96 @@ namespace detail {
  * Project takes an ordered set of attribute names (AttributeNameVec) and
  * returns only those attributes from the child iterator.
  *
- * The returned value() is always an ordered_map_t
+ * The returned value() is a vector_pair_t whose keys are the attribute
+ * names, in order, and are shared by all rows. Missing attributes are
+ * blank. The projection is computed once per row, on the first call to
+ * value(). With setBorrowStrings() string attributes of a child whose
+ * values are stable are returned as StringPieces into them instead of
+ * being copied.
+ *
+ * The projected attributes, plus :id and :time, are pushed down to the
+ * child with setRequiredColumns(), so leaves that support it decode only
+ * those.
  */
 template <typename T=Item>
 class ProjectIterator : public WrappedIterator<T> {
 public:
   ProjectIterator(Iterator<T>* iter, const AttributeNameVec& attrNames)
     : WrappedIterator<T>(iter)
-    , attrNames_(attrNames) {}
-
+    , attrNames_(attrNames)
+    , slots_(attrNames.begin(), attrNames.end()) {
+    auto columns = attrNames;
+    for (const auto& key : {kIdKey, kTimeKey}) {
+      if (std::find(columns.begin(), columns.end(), key) == columns.end()) {
+        columns.push_back(key);
+      }
+    }
+    if (iter != nullptr) {
+      iter->setRequiredColumns(columns);
+    }
+  }
 
   virtual const T& value() const override;
 
+  // Off by default, borrowed attributes are StringPieces instead of
+  // std::strings, so readers must accept both
+  void setBorrowStrings(bool borrow) { borrowStrings_ = borrow; }
+
   virtual bool orderPreserving() const override {
     return true;
   }
 
+  ssize_t countRemaining(size_t limit) override {
+    current_ = nullptr;
+    return this->innerIter_->countRemaining(limit);
+  }
+
+  ssize_t estimateRemaining() const override {
+    return this->innerIter_->estimateRemaining();
+  }
+
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    return this->innerIter_->saveCursor(cursor, rewind);
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    return this->innerIter_->restoreCursor(cursor);
+  }
+
+  bool pushDownReverse() override {
+    return this->innerIter_->pushDownReverse();
+  }
+
+  bool seekRandom() override {
+    current_ = nullptr;
+    return this->innerIter_->seekRandom();
+  }
+
+  bool cacheable() const override { return this->innerIter_->cacheable(); }
+
 protected:
  bool doNext() override;
 
  bool doSkipTo(id_t id) override;
 
+ // Only the row skipped to is projected, if value() is called
+ bool doSkip(size_t n) override;
+
+ bool doReset() override {
+   current_ = nullptr;
+   return this->innerIter_->reset();
+ }
+
 private:
-  AttributeNameVec attrNames_;
+  const T* project() const;
+
+  // Keys of every projected row
+  const AttributeNameVec attrNames_;
+  mutable std::vector<AttributeSlot> slots_;
+  bool borrowStrings_{false};
   mutable ItemOptimized value_;
+  // Projection of the current row, nullptr until value() is called
+  mutable const T* current_{nullptr};
 };
 
 }
@@ -5,6 +5,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <folly/Random.h>
 
 namespace iterlib {
@@ -20,7 +24,7 @@ bool RandomIterator<T>::doNext() {
   if (firstTime_) {
     firstTime_ = false;
     getRandomSamples();
-    std::make_heap(randomsamples_.begin(), randomsamples_.end());
+    std::make_heap(randomsamples_.begin(), randomsamples_.end(), Less());
   } else {
     randomsamples_.pop_back();
   }
@@ -30,44 +34,87 @@ bool RandomIterator<T>::doNext() {
     return false;
   }
 
-  std::pop_heap(randomsamples_.begin(), randomsamples_.end());
+  std::pop_heap(randomsamples_.begin(), randomsamples_.end(), Less());
   return true;
 }
 
-// reservoir sampling
+template <typename T>
+void RandomIterator<T>::keep(size_t slot) {
+  if (!this->innerIter_->stableValues()) {
+    if (slot == copies_.size()) {
+      copies_.push_back(this->innerIter_->value());
+    } else {
+      copies_[slot] = this->innerIter_->value();
+    }
+    return;
+  }
+  if (slot == randomsamples_.size()) {
+    randomsamples_.push_back(&this->innerIter_->value());
+  } else {
+    randomsamples_[slot] = &this->innerIter_->value();
+  }
+}
+
+template <typename T>
+double RandomIterator<T>::randomOpen01() {
+  double u;
+  do {
+    u = folly::Random::randDouble01();
+  } while (u == 0);
+  return u;
+}
+
 template <typename T>
 void RandomIterator<T>::getRandomSamples() {
   if (count_ <= 0) {
     return;
   }
+  if (mode_ == Mode::RANDOM_SEEK && this->innerIter_->seekRandom()) {
+    keep(0);
+    for (int32_t i = 1; i < count_ && this->innerIter_->seekRandom(); i++) {
+      keep(i);
+    }
+  } else {
+    sampleAll();
+  }
+
+  if (!copies_.empty()) {
+    randomsamples_.reserve(copies_.size());
+    for (const auto& copy : copies_) {
+      randomsamples_.push_back(&copy);
+    }
+  }
+}
+
+template <typename T>
+void RandomIterator<T>::sampleAll() {
   // read count_
   int32_t index = 0;
-  while (index < count_ ) {
+  while (index < count_) {
     if (!this->innerIter_->next()) {
-      return;
+      break;
     }
-    randomsamples_.push_back(this->innerIter_->value());
+    keep(index);
     index++;
   }
 
   // Replace elements in random samples with later results.
-  // using reservoir sampling
-  int skip = 0;
-  while (1) {
-    ++skip;
-    int x = folly::Random::rand32(index+1);
-    if ( x < count_) {
-      if (!this->innerIter_->skip(skip)) {
-        return;
+  // w is the largest of count_ uniform draws, whose distribution gives
+  // the number of rows until the next one that enters the reservoir.
+  if (index == count_) {
+    double w = std::exp(std::log(randomOpen01()) / count_);
+    while (true) {
+      const double skip =
+          std::floor(std::log(randomOpen01()) / std::log1p(-w));
+      if (!(skip < std::numeric_limits<size_t>::max() - 1) ||
+          !this->innerIter_->skip(static_cast<size_t>(skip) + 1)) {
+        break;
       }
-      // swap results
-      skip = 0;
-      randomsamples_[x] = this->innerIter_->value();
+      keep(folly::Random::rand32(count_));
+      w *= std::exp(std::log(randomOpen01()) / count_);
     }
-    ++index;
   }
-
-};
+}
 
 }
 }
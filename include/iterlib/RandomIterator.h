@@ -5,35 +5,69 @@
 namespace iterlib {
 namespace detail {
 
-// Get random results from the inner Iterator
+// Returns a uniform random sample of count rows of the child, without
+// replacement, in descending order. If the child has fewer rows, all of
+// them are returned.
 //
-// Uses reservoir sampling:
-// https://en.wikipedia.org/wiki/Reservoir_sampling
+// Uses reservoir sampling with geometric skips (Algorithm L,
+// https://en.wikipedia.org/wiki/Reservoir_sampling): after the first
+// count rows, the number of rows to pass over before the next
+// replacement is drawn directly and skipped with Iterator::skip(), so
+// only O(count * log(n / count)) random numbers are drawn and skipped
+// rows are never built by children with a native skip().
 //
-// If the inner iterator has fewer than the
-// requested items, we select all of them.
+// Samples are held by pointer when the child's values are stable, and
+// copied otherwise.
 template <typename T=Item>
 class RandomIterator : public WrappedIterator<T> {
 public:
-  RandomIterator(Iterator<T>* iter, int count)
+  enum class Mode {
+    // Reads the whole child, the sample is exactly uniform
+    RESERVOIR,
+    // Picks each row with Iterator::seekRandom(), eg: a few seeks into a
+    // RocksDB range instead of a scan of it. Rows are picked with
+    // replacement, so a row may be returned more than once, and only
+    // about uniformly: see the child's seekRandom() for its bias. Falls
+    // back to RESERVOIR if the child doesn't support seekRandom().
+    RANDOM_SEEK,
+  };
+
+  RandomIterator(Iterator<T>* iter, int count, Mode mode = Mode::RESERVOIR)
     : WrappedIterator<T>(iter)
     , count_(count)
+    , mode_(mode)
     , firstTime_(true){
   }
 
   virtual const T& value() const override {
-    return randomsamples_.back();
+    return *randomsamples_.back();
   }
 
+  // Samples stay until the iterator is destroyed
+  bool stableValues() const override { return true; }
+
 protected:
  bool doNext() override;
 
 private:
+  struct Less {
+    bool operator()(const T* a, const T* b) const { return *a < *b; }
+  };
+
   void getRandomSamples();
+  // Reservoir sampling over the whole child
+  void sampleAll();
+  // Keeps the child's current row as sample number slot
+  void keep(size_t slot);
+  // Uniform in (0, 1), so its log is finite
+  static double randomOpen01();
   int32_t count_;
+  Mode mode_;
   bool firstTime_;
 
-  std::vector<T> randomsamples_;
+  std::vector<const T*> randomsamples_;
+  // Backs randomsamples_ when the child's values aren't stable
+  std::vector<T> copies_;
 };
 
 }
@@ -8,10 +8,28 @@
 namespace iterlib {
 namespace detail {
 
+template <typename T>
+folly::Future<folly::Unit> ReverseIterator<T>::prepare() {
+  if (!this->prepared_) {
+    native_ = this->innerIter_->pushDownReverse();
+  }
+  return WrappedIterator<T>::prepare();
+}
+
 template <typename T>
 void ReverseIterator<T>::load() {
+  if (this->innerIter_->stableValues()) {
+    while (this->innerIter_->next()) {
+      rows_.push_back(&this->innerIter_->value());
+    }
+    return;
+  }
   while (this->innerIter_->next()) {
-    results_.emplace_back(this->innerIter_->value());
+    copies_.emplace_back(this->innerIter_->value());
+  }
+  rows_.reserve(copies_.size());
+  for (const auto& row : copies_) {
+    rows_.push_back(&row);
   }
 }
 
@@ -20,16 +38,23 @@ bool ReverseIterator<T>::doNext() {
   if (this->done()) {
     return false;
   }
+  if (native_) {
+    if (!this->innerIter_->next()) {
+      this->setDone();
+      return false;
+    }
+    return true;
+  }
 
   // only get samples in the first time
   if (firstTime_) {
     firstTime_ = false;
     load();
   } else {
-    results_.pop_back();
+    rows_.pop_back();
   }
 
-  if (results_.empty()) {
+  if (rows_.empty()) {
     this->setDone();
     return false;
   }
@@ -37,5 +62,33 @@ bool ReverseIterator<T>::doNext() {
   return true;
 }
 
+template <typename T>
+bool ReverseIterator<T>::doSkip(size_t n) {
+  if (this->done() || n == 0) {
+    return !this->done();
+  }
+  if (native_) {
+    if (!this->innerIter_->skip(n)) {
+      this->setDone();
+      return false;
+    }
+    return true;
+  }
+
+  // The first row returned is at the back, and isn't popped
+  if (firstTime_) {
+    firstTime_ = false;
+    load();
+    n--;
+  }
+  if (n >= rows_.size()) {
+    rows_.clear();
+    this->setDone();
+    return false;
+  }
+  rows_.erase(rows_.end() - n, rows_.end());
+  return true;
+}
+
 }
 }
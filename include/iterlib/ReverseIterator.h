@@ -6,6 +6,12 @@ namespace iterlib {
 namespace detail {
 
 // reverse the order of the WrappedIterator
+//
+// Children that can produce their rows backward themselves, such as
+// RocksDBIterator, are asked to in prepare() (see
+// Iterator::pushDownReverse()), which streams rows without buffering.
+// Otherwise all rows are loaded first, holding pointers to them if the
+// child's values are stable and copies otherwise.
 template <typename T=Item>
 class ReverseIterator : public WrappedIterator<T> {
 public:
@@ -15,19 +21,44 @@ public:
   }
 
   virtual const T& value() const override {
-    return results_.back();
+    if (native_) {
+      return this->innerIter_->value();
+    }
+    return rows_.empty() ? T::kEmptyItem : *rows_.back();
+  }
+
+  virtual folly::Future<folly::Unit> prepare() override;
+
+  // Buffered rows stay until the iterator is destroyed
+  bool stableValues() const override {
+    return native_ ? this->innerIter_->stableValues() : true;
+  }
+
+  ssize_t countRemaining(size_t limit) override {
+    return native_ ? this->innerIter_->countRemaining(limit) : -1;
+  }
+
+  ssize_t estimateRemaining() const override {
+    return native_ ? this->innerIter_->estimateRemaining() : -1;
   }
 
 protected:
  bool doNext() override;
 
+ bool doSkip(size_t n) override;
+
 private:
   // first time load all data into memory
   void load();
 
   bool firstTime_;
+  // Whether the child returns its rows in reverse order itself
+  bool native_{false};
 
-  std::vector<T> results_;
+  // Rows left, the next one at the back
+  std::vector<const T*> rows_;
+  // Backs rows_ when the child's values aren't stable
+  std::vector<T> copies_;
 };
 
 }
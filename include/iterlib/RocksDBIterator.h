@@ -4,10 +4,17 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 #pragma once
 
+#include <cmath>
+#include <functional>
 #include <list>
 #include <memory>
+#include <stdexcept>
+#include <vector>
+#include <folly/Random.h>
+#include <rocksdb/db.h>
 #include <rocksdb/iterator.h>
 
+#include "iterlib/Arena.h"
 #include "iterlib/Iterator.h"
 
 namespace iterlib {
@@ -20,34 +27,532 @@ inline folly::StringPiece sliceToStringPiece(const rocksdb::Slice s) {
 template <typename T=Item>
 class RocksDBIterator : public Iterator<T> {
  public:
+  // Maps an inclusive range of attribute values to the key range
+  // [start, limit) of the rows having them, in comparator order. An empty
+  // start or limit leaves that side unbounded.
+  using KeyRangeEncoder = std::function<std::pair<std::string, std::string>(
+      int64_t min, int64_t max)>;
+
+  // Turns the value of a row into an item. columns is null when all
+  // attributes are needed, otherwise the decoder may skip the others.
+  using ValueDecoder = std::function<T(folly::StringPiece value,
+                                       const AttributeNameVec* columns)>;
+
   RocksDBIterator(rocksdb::Iterator* iter) : iter_(iter) {}
 
-  const T& key() const override { return keys_.back(); }
+  // Creates the rocksdb iterator in prepare(), which lets filters above
+  // push key bounds into options, see setKeyRangeEncoder()
+  RocksDBIterator(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf,
+                  const rocksdb::ReadOptions& options)
+      : options_(options), db_(db), cf_(cf) {}
+
+  const T& key() const override { return *key_; }
+
+  const T& value() const override { return *value_; }
 
-  const T& value() const override { return values_.back(); }
+  // Every row ever returned is kept in values_
+  bool stableValues() const override { return true; }
+
+  // Describes the key range [start, limit) of the column family that
+  // iter scans, in comparator order. An empty start or limit leaves that
+  // side unbounded. Iterators created from a DB scan the pushed down
+  // bounds of their column family, others need this for
+  // estimateRemaining().
+  void setRange(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf,
+                std::string start, std::string limit) {
+    db_ = db;
+    cf_ = cf;
+    rangeStart_ = std::move(start);
+    rangeLimit_ = std::move(limit);
+    hasRange_ = true;
+    rangeLoaded_ = false;
+  }
+
+  // Approximate number of keys between the current position and the end
+  // of the range: SST bytes in the range divided by the average entry
+  // size of the overlapping tables, plus the memtable entry count. -1 if
+  // the range isn't known. Deleted and overwritten keys are counted until
+  // compaction.
+  ssize_t estimateRemaining() const override {
+    if (this->done() || emptyRange_ || (iter_ && !iter_->Valid())) {
+      return 0;
+    }
+    if (!loadRangeEnds()) {
+      return -1;
+    }
+    if (rangeEmpty_) {
+      return 0;
+    }
+    // Once positioned the rows left are [current, last], or [first,
+    // current] for reverse scans
+    rocksdb::Slice first(rangeFirst_);
+    rocksdb::Slice last(rangeLast_);
+    if (iter_) {
+      if (reverse_) {
+        last = iter_->key();
+      } else {
+        first = iter_->key();
+      }
+    }
+    const ssize_t estimate = approximateKeys(first, last);
+    // The current key has already been returned
+    if (estimate < 0 || firstTime_) {
+      return estimate;
+    }
+    return std::max<ssize_t>(0, estimate - 1);
+  }
+
+  // Rows are keyed by attribute (:time or :id) in a way encoder
+  // understands. Only honored by iterators created from a DB.
+  void setKeyRangeEncoder(const std::string& attribute,
+                          KeyRangeEncoder encoder) {
+    encoderAttribute_ = attribute;
+    encoder_ = std::move(encoder);
+  }
+
+  // Without a decoder value() is the raw value of the row
+  void setValueDecoder(ValueDecoder decoder) {
+    decoder_ = std::move(decoder);
+  }
+
+  // ValueDecoder for values written with dynamic::toBinary(). Strings of
+  // the row point into the value, which lives as long as the iterator,
+  // and only the required columns of an object are decoded.
+  static T decodeBinary(folly::StringPiece value,
+                        const AttributeNameVec* columns) {
+    variant::BinaryView view(value);
+    if (columns == nullptr || !view.isObject()) {
+      return T(view.decode());
+    }
+    variant::unordered_map_t row;
+    variant::BinaryView column;
+    for (const auto& name : *columns) {
+      if (view.find(name, &column)) {
+        row.emplace(name, column.decode());
+      }
+    }
+    return T(dynamic(std::move(row)));
+  }
+
+  // Only honored once a decoder is set, the raw value has all attributes
+  bool setRequiredColumns(const AttributeNameVec& columns) override {
+    if (!decoder_) {
+      return false;
+    }
+    columns_ = columns;
+    hasColumns_ = true;
+    return true;
+  }
+
+  // Scans the range backward with Prev(). Only honored by iterators
+  // created from a DB.
+  bool pushDownReverse() override {
+    if (iter_ || db_ == nullptr) {
+      return false;
+    }
+    reverse_ = true;
+    return true;
+  }
+
+  // Turns bounds on the encoded attribute into iterate_lower_bound and
+  // iterate_upper_bound, and seeks to the lower one
+  bool pushDownRange(const std::string& attribute, int64_t min,
+                     int64_t max) override {
+    if (iter_ || !encoder_ || attribute != encoderAttribute_) {
+      return false;
+    }
+    if (min > max) {
+      emptyRange_ = true;
+      return true;
+    }
+    std::tie(lowerBound_, upperBound_) = encoder_(min, max);
+    rangeLoaded_ = false;
+    return true;
+  }
+
+  folly::Future<folly::Unit> prepare() override {
+    if (!iter_ && db_ != nullptr) {
+      if (!lowerBound_.empty()) {
+        lowerSlice_ = lowerBound_;
+        options_.iterate_lower_bound = &lowerSlice_;
+      }
+      if (!upperBound_.empty()) {
+        upperSlice_ = upperBound_;
+        options_.iterate_upper_bound = &upperSlice_;
+      }
+      iter_.reset(db_->NewIterator(options_, cf_));
+      if (reverse_) {
+        // Honors iterate_upper_bound
+        iter_->SeekToLast();
+      } else if (lowerBound_.empty()) {
+        iter_->SeekToFirst();
+      } else {
+        iter_->Seek(lowerSlice_);
+      }
+    }
+    if (hasResumeKey_ && !emptyRange_) {
+      if (reverse_) {
+        iter_->SeekForPrev(resumeKey_);
+      } else {
+        iter_->Seek(resumeKey_);
+      }
+      if (skipResumeKey_ && iter_->Valid() &&
+          iter_->key() == rocksdb::Slice(resumeKey_)) {
+        // Treated as already returned, the first next() moves past it
+        firstTime_ = false;
+      }
+    }
+    if (iter_ && iter_->Valid()) {
+      startKey_ = iter_->key().ToString();
+      startValid_ = true;
+      startFirstTime_ = firstTime_;
+    }
+    return Iterator<T>::prepare();
+  }
+
+  // The cursor is kCursorStart before the first row, kCursorEnd once the
+  // range is exhausted, and otherwise [key, skip]: resume at the first
+  // key not before key (not after it for reverse scans), moving past key
+  // itself if skip is 1. A resumed scan that hasn't returned a row yet
+  // saves the cursor it was restored from.
+  bool saveCursor(dynamic* cursor, bool rewind = false) const override {
+    if (emptyRange_ || this->done()) {
+      *cursor = static_cast<int64_t>(kCursorEnd);
+    } else if ((firstTime_ || !iter_) && hasResumeKey_) {
+      *cursor = variant::vector_dynamic_t{
+          resumeKey_, static_cast<int64_t>(skipResumeKey_)};
+    } else if (firstTime_ || !iter_) {
+      *cursor = static_cast<int64_t>(kCursorStart);
+    } else if (!iter_->Valid()) {
+      *cursor = static_cast<int64_t>(kCursorEnd);
+    } else {
+      const bool skip = !(rewind && this->hasCurrent());
+      *cursor = variant::vector_dynamic_t{iter_->key().ToString(),
+                                          static_cast<int64_t>(skip)};
+    }
+    return true;
+  }
+
+  bool restoreCursor(const dynamic& cursor) override {
+    if (cursor.is_of<int64_t>()) {
+      const auto state = cursor.get<int64_t>();
+      if (state != kCursorStart && state != kCursorEnd) {
+        throw std::invalid_argument("Unknown RocksDBIterator cursor");
+      }
+      emptyRange_ = emptyRange_ || state == kCursorEnd;
+      return true;
+    }
+    const auto& fields = this->cursorFields(cursor, 2);
+    if (!fields[0].template is_of<std::string>()) {
+      throw std::invalid_argument("Expected a RocksDBIterator cursor key");
+    }
+    resumeKey_ = fields[0].template getRef<std::string>();
+    skipResumeKey_ = this->cursorIndex(fields[1]) != 0;
+    hasResumeKey_ = true;
+    return true;
+  }
+
+  // Seeks to a random point of the key range, found by bisecting on
+  // approximate range sizes. Rows are picked about in proportion to the
+  // bytes they take down to the granularity of those sizes (SST blocks
+  // and memtables), and below that in proportion to the gap in key space
+  // before them, read as big endian numbers. Rows after sparse parts of
+  // the key space are therefore favored, see RandomIterator::Mode.
+  //
+  // Only supported when the range is known, see setRange(), and samples
+  // stay within it. Returns false without moving the scan if no row could
+  // be picked.
+  bool seekRandom() override {
+    if (!iter_ || emptyRange_ || !iter_->Valid() || !loadRangeEnds() ||
+        rangeEmpty_) {
+      return false;
+    }
+    const double target = folly::Random::randDouble01();
+    double t = target;
+    const uint64_t total = approximateSize(rangeLast_);
+    if (total > 0) {
+      double lo = 0;
+      double hi = 1;
+      for (int i = 0; i < kBisectSteps; i++) {
+        t = (lo + hi) / 2;
+        if (approximateSize(interpolateKey(t)) < target * total) {
+          lo = t;
+        } else {
+          hi = t;
+        }
+      }
+      t = (lo + hi) / 2;
+    }
+    const std::string position = iter_->key().ToString();
+    iter_->Seek(interpolateKey(t));
+    // Rows may have been written or deleted since the ends were found
+    const auto* cmp = cf_->GetComparator();
+    if (!iter_->Valid() || cmp->Compare(iter_->key(), rangeFirst_) < 0 ||
+        cmp->Compare(iter_->key(), rangeLast_) > 0) {
+      if (reverse_) {
+        iter_->SeekForPrev(position);
+      } else {
+        iter_->Seek(position);
+      }
+      return false;
+    }
+    firstTime_ = false;
+    // Where this is in the scan isn't known, so the row isn't reused
+    index_ = kUnknownIndex;
+    loadRow();
+    return true;
+  }
+
+  // Walks the range without building key/value items
+  ssize_t countRemaining(size_t limit) override {
+    size_t count = 0;
+    if (limit == 0) {
+      return 0;
+    }
+    if (emptyRange_) {
+      this->setDone();
+      return 0;
+    }
+    if (firstTime_) {
+      firstTime_ = false;
+    } else if (iter_->Valid()) {
+      step();
+    }
+    while (count < limit && iter_->Valid()) {
+      count++;
+      if (count < limit) {
+        step();
+      }
+    }
+    if (!iter_->Valid()) {
+      this->setDone();
+    }
+    return count;
+  }
 
  protected:
   bool doNext() override {
+    if (emptyRange_) {
+      return false;
+    }
     if (!firstTime_) {
-      iter_->Next();
+      step();
     } else {
       firstTime_ = false;
     }
     auto ret = iter_->Valid();
     if (ret) {
-      keys_.emplace_back(sliceToStringPiece(iter_->key()));
-      values_.emplace_back(sliceToStringPiece(iter_->value()));
+      loadRow();
     }
     return ret;
   }
 
+  // Seeks back to where prepare() left the rocksdb iterator. The rows
+  // built before are returned again rather than built anew, so memory
+  // doesn't grow with the number of resets.
+  bool doReset() override {
+    if (!iter_) {
+      return false;
+    }
+    if (startValid_) {
+      if (reverse_) {
+        iter_->SeekForPrev(startKey_);
+      } else {
+        iter_->Seek(startKey_);
+      }
+    }
+    firstTime_ = startFirstTime_;
+    index_ = 0;
+    return true;
+  }
+
+  // Makes the row at iter_ current, reusing it if it was built before
+  void loadRow() {
+    if (index_ < rows_.size() && rows_[index_].value != nullptr) {
+      key_ = rows_[index_].key;
+      value_ = rows_[index_].value;
+      return;
+    }
+    addRow();
+    if (index_ != kUnknownIndex) {
+      if (index_ >= rows_.size()) {
+        rows_.resize(index_ + 1, Row{nullptr, nullptr});
+      }
+      rows_[index_] = Row{key_, value_};
+    }
+  }
+
+  // Rows point into the slices of iter_ if they are pinned (see
+  // ReadOptions::pin_data), otherwise into copies, since the slices
+  // change when iter_ moves
+  void addRow() {
+    auto key = sliceToStringPiece(iter_->key());
+    auto value = sliceToStringPiece(iter_->value());
+    if (!pinned()) {
+      key = arena_.copy(key);
+      value = arena_.copy(value);
+    }
+    keys_.emplace_back(key);
+    if (decoder_) {
+      values_.emplace_back(
+          decoder_(value, hasColumns_ ? &columns_ : nullptr));
+    } else {
+      values_.emplace_back(value);
+    }
+    key_ = &keys_.back();
+    value_ = &values_.back();
+  }
+
+  // Whether the key and value of the current row stay valid as long as
+  // iter_ does, as ReadOptions::pin_data asks for. Also holds for
+  // iterators passed in, whose options aren't known.
+  bool pinned() const {
+    std::string property;
+    const auto status =
+        iter_->GetProperty("rocksdb.iterator.is-key-pinned", &property);
+    return status.ok() && property == "1";
+  }
+
+  // Finds the first and last keys of the scanned range once, with an
+  // iterator of its own so that iter_ stays where it is. Returns false if
+  // the range isn't known, see setRange().
+  bool loadRangeEnds() const {
+    if (rangeLoaded_) {
+      return true;
+    }
+    if (db_ == nullptr) {
+      return false;
+    }
+    const auto& start = hasRange_ ? rangeStart_ : lowerBound_;
+    const auto& limit = hasRange_ ? rangeLimit_ : upperBound_;
+    rocksdb::ReadOptions options = options_;
+    const rocksdb::Slice lower(start);
+    const rocksdb::Slice upper(limit);
+    options.iterate_lower_bound = start.empty() ? nullptr : &lower;
+    options.iterate_upper_bound = limit.empty() ? nullptr : &upper;
+    std::unique_ptr<rocksdb::Iterator> iter(db_->NewIterator(options, cf_));
+    if (start.empty()) {
+      iter->SeekToFirst();
+    } else {
+      iter->Seek(lower);
+    }
+    rangeEmpty_ = !iter->Valid();
+    if (!rangeEmpty_) {
+      rangeFirst_ = iter->key().ToString();
+      // Honors iterate_upper_bound
+      iter->SeekToLast();
+      rangeLast_ = iter->Valid() ? iter->key().ToString() : rangeFirst_;
+    }
+    rangeLoaded_ = true;
+    return true;
+  }
+
+  // Approximate number of keys in [first, last], -1 if unknown
+  ssize_t approximateKeys(const rocksdb::Slice& first,
+                          const rocksdb::Slice& last) const {
+    rocksdb::Range range(first, last);
+    uint64_t fileBytes = 0;
+    db_->GetApproximateSizes(cf_, &range, 1, &fileBytes,
+                             rocksdb::DB::INCLUDE_FILES);
+
+    double fileEntries = 0;
+    if (fileBytes > 0) {
+      rocksdb::TablePropertiesCollection props;
+      if (!db_->GetPropertiesOfTablesInRange(cf_, &range, 1, &props).ok()) {
+        return -1;
+      }
+      uint64_t dataSize = 0;
+      uint64_t numEntries = 0;
+      for (const auto& p : props) {
+        dataSize += p.second->data_size;
+        numEntries += p.second->num_entries;
+      }
+      if (dataSize > 0) {
+        fileEntries = double(fileBytes) * numEntries / dataSize;
+      }
+    }
+
+    uint64_t memCount = 0;
+    uint64_t memBytes = 0;
+    db_->GetApproximateMemTableStats(cf_, range, &memCount, &memBytes);
+
+    // The range excludes last
+    return std::llround(fileEntries) + memCount + 1;
+  }
+
+  // Bytes between the first key of the range and key
+  uint64_t approximateSize(const std::string& key) const {
+    if (db_ == nullptr) {
+      return 0;
+    }
+    rocksdb::Range range(rangeFirst_, key);
+    uint64_t size = 0;
+    db_->GetApproximateSizes(cf_, &range, 1, &size,
+                             rocksdb::DB::INCLUDE_FILES |
+                                 rocksdb::DB::INCLUDE_MEMTABLES);
+    return size;
+  }
+
+  // The key at fraction t of the way from the first to the last key of
+  // the range, reading the 8 bytes after their common prefix as numbers
+  std::string interpolateKey(double t) const {
+    const auto& a = rangeFirst_;
+    const auto& b = rangeLast_;
+    size_t prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && a[prefix] == b[prefix]) {
+      prefix++;
+    }
+    auto number = [prefix](const std::string& s) {
+      uint64_t n = 0;
+      for (size_t i = prefix; i < prefix + 8; i++) {
+        n = (n << 8) | (i < s.size() ? static_cast<uint8_t>(s[i]) : 0);
+      }
+      return n;
+    };
+    const uint64_t x = number(a);
+    const uint64_t y = number(b);
+    const uint64_t n = x <= y ? x + static_cast<uint64_t>((y - x) * t)
+                              : x - static_cast<uint64_t>((x - y) * t);
+    std::string key = a.substr(0, prefix);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      key.push_back(static_cast<char>((n >> shift) & 0xff));
+    }
+    return key;
+  }
+
+  // Steps over the skipped rows with Next() or Prev() alone, only the row
+  // skipped to is decoded
+  bool doSkip(size_t n) override {
+    if (n == 0 || this->done()) {
+      return !this->done();
+    }
+    for (; n > 1 && !emptyRange_ && iter_->Valid(); n--) {
+      step();
+    }
+    if (emptyRange_ || !iter_->Valid() || !doNext()) {
+      this->setDone();
+      return false;
+    }
+    return true;
+  }
+
+  void step() {
+    if (reverse_) {
+      iter_->Prev();
+    } else {
+      iter_->Next();
+    }
+    if (index_ != kUnknownIndex) {
+      index_++;
+    }
+  }
+
   /*
    * TODO: Optimize these methods
 
      virtual bool doSkipTo(id_t id);
      virtual bool doSkipToPredicate(AttributeNameVec predicate,
                                     const Item& target);
-     virtual bool doSkip(size_t n);
 
    */
 
@@ -58,11 +563,70 @@ class RocksDBIterator : public Iterator<T> {
   // via key()/value() methods remain valid until the iterator
   // is destroyed. Complexity of lookup irrelevant. Hence std::list
   // vector invalidates references on re-allocation
-  mutable std::list<T> keys_;
-  mutable std::list<T> values_;
+  //
+  // The rows, their list nodes and the copies of unpinned key and value
+  // bytes are never freed before the iterator, so they all come from
+  // arena_. What the rows allocate themselves, eg: decoded containers,
+  // comes from the global allocator.
+  Arena arena_;
+  mutable std::list<T, ArenaAllocator<T>> keys_{ArenaAllocator<T>(&arena_)};
+  mutable std::list<T, ArenaAllocator<T>> values_{
+      ArenaAllocator<T>(&arena_)};
+  const T* key_ = nullptr;
+  const T* value_ = nullptr;
+
+  // The rows built so far by their position in the scan since prepare(),
+  // see doReset(). Null for rows that were stepped over.
+  struct Row {
+    const T* key;
+    const T* value;
+  };
+  std::vector<Row> rows_;
+  static constexpr size_t kUnknownIndex = size_t(-1);
+  // Position of iter_ in the scan since prepare(), kUnknownIndex after a
+  // random seek
+  size_t index_ = 0;
 
   std::unique_ptr<rocksdb::Iterator> iter_;
   bool firstTime_ = true;
+
+  // Pushed down bounds, the slices in options_ point into them
+  rocksdb::ReadOptions options_;
+  std::string encoderAttribute_;
+  KeyRangeEncoder encoder_;
+  std::string lowerBound_;
+  std::string upperBound_;
+  rocksdb::Slice lowerSlice_;
+  rocksdb::Slice upperSlice_;
+  bool emptyRange_ = false;
+  bool reverse_ = false;
+
+  static constexpr int kBisectSteps = 20;
+
+  enum : int64_t { kCursorStart = 0, kCursorEnd = 1 };
+  std::string resumeKey_;
+  bool skipResumeKey_ = false;
+  bool hasResumeKey_ = false;
+
+  // Position after prepare(), for reset()
+  std::string startKey_;
+  bool startValid_ = false;
+  bool startFirstTime_ = true;
+
+  ValueDecoder decoder_;
+  AttributeNameVec columns_;
+  bool hasColumns_ = false;
+
+  rocksdb::DB* db_ = nullptr;
+  rocksdb::ColumnFamilyHandle* cf_ = nullptr;
+  std::string rangeStart_;
+  std::string rangeLimit_;
+  bool hasRange_ = false;
+  // First and last keys of the range, see loadRangeEnds()
+  mutable std::string rangeFirst_;
+  mutable std::string rangeLast_;
+  mutable bool rangeEmpty_ = false;
+  mutable bool rangeLoaded_ = false;
 };
 }
 
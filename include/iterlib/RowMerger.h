@@ -0,0 +1,89 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "iterlib/dynamic.h"
+
+namespace iterlib {
+
+// How two values of the same attribute are combined
+enum class MergeStrategy {
+  // dynamic::merge(): objects are collected into a vector_dynamic_t, other
+  // values are combined with +=
+  DEFAULT = 0,
+  LAST_WINS,
+  FIRST_WINS,
+  // Values are collected into a vector_dynamic_t, vectors are concatenated
+  APPEND,
+  // Numbers are added up, anything else throws std::invalid_argument
+  SUM,
+};
+
+/**
+ * Merges map rows into one, attribute by attribute, in place.
+ *
+ * Attributes are copied once straight from the source row into the target
+ * map, which is reserved up front, and combined in place where an
+ * attribute is in both. Nothing is formatted unless a merge fails.
+ */
+class RowMerger {
+ public:
+  void setDefaultStrategy(MergeStrategy strategy) {
+    defaultStrategy_ = strategy;
+  }
+
+  void setStrategy(const std::string& attribute, MergeStrategy strategy) {
+    auto it = std::lower_bound(strategies_.begin(), strategies_.end(),
+                               attribute, attributeLess);
+    if (it != strategies_.end() && it->first == attribute) {
+      it->second = strategy;
+    } else {
+      strategies_.emplace(it, attribute, strategy);
+    }
+  }
+
+  MergeStrategy strategyFor(folly::StringPiece attribute) const {
+    if (strategies_.empty()) {
+      return defaultStrategy_;
+    }
+    const auto it = std::lower_bound(strategies_.begin(), strategies_.end(),
+                                     attribute, attributeLess);
+    if (it == strategies_.end() || folly::StringPiece(it->first) != attribute) {
+      return defaultStrategy_;
+    }
+    return it->second;
+  }
+
+  // Merges the attributes of from into *into. If *into is a view or a
+  // vector_pair_t it is first converted to a map that can take new keys.
+  // Rows that are not maps are combined as a whole with the default
+  // strategy.
+  void merge(dynamic* into, const dynamic& from) const;
+
+  static void combine(dynamic* into, const dynamic& from,
+                      MergeStrategy strategy);
+
+ private:
+  template <typename Map, typename Key>
+  void mergeEntry(Map* into, const Key& key, const dynamic& value) const;
+
+  typedef std::vector<std::pair<std::string, MergeStrategy>> Strategies;
+
+  static bool attributeLess(const Strategies::value_type& entry,
+                            folly::StringPiece attribute) {
+    return folly::StringPiece(entry.first) < attribute;
+  }
+
+  MergeStrategy defaultStrategy_{MergeStrategy::DEFAULT};
+  // Sorted by attribute, so lookups by StringPiece don't allocate
+  Strategies strategies_;
+};
+
+}
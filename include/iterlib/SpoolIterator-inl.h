@@ -0,0 +1,106 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace iterlib {
+namespace detail {
+
+template <typename T>
+std::unique_ptr<SpoolIterator<T>> Spool<T>::newCursor() {
+  if (dropped_ > 0) {
+    throw std::logic_error("Spool rows were already dropped, create all "
+                           "cursors before advancing any of them");
+  }
+  auto pos = positions_.insert(positions_.end(), 0);
+  return std::unique_ptr<SpoolIterator<T>>(
+      new SpoolIterator<T>(this->shared_from_this(), pos));
+}
+
+template <typename T>
+folly::Future<folly::Unit> Spool<T>::prepare() {
+  if (!preparing_) {
+    preparing_ = true;
+    source_->prepare().then([this](folly::Try<folly::Unit>&& t) {
+      prepared_.setTry(std::move(t));
+    });
+  }
+  return prepared_.getFuture();
+}
+
+template <typename T>
+const T* Spool<T>::fetch(Position pos) {
+  size_t index = *pos - dropped_;
+  if (index == rows_.size()) {
+    if (sourceDone_ || !source_->next()) {
+      sourceDone_ = true;
+      return nullptr;
+    }
+    if (source_->stableValues()) {
+      rows_.push_back(&source_->value());
+    } else {
+      copies_.push_back(source_->value());
+      rows_.push_back(&copies_.back());
+    }
+  }
+  const T* row = rows_[index];
+  ++*pos;
+  if (mode_ == Mode::STREAMING) {
+    trim();
+  }
+  return row;
+}
+
+template <typename T>
+void Spool<T>::release(Position pos) {
+  positions_.erase(pos);
+  if (mode_ == Mode::STREAMING) {
+    trim();
+  }
+}
+
+template <typename T>
+void Spool<T>::trim() {
+  if (positions_.empty()) {
+    return;
+  }
+  // A cursor still returns the row it last fetched from value()
+  size_t keep = std::numeric_limits<size_t>::max();
+  for (size_t pos : positions_) {
+    keep = std::min(keep, pos > 0 ? pos - 1 : 0);
+  }
+  while (dropped_ < keep && !rows_.empty()) {
+    rows_.pop_front();
+    if (!copies_.empty()) {
+      copies_.pop_front();
+    }
+    dropped_++;
+  }
+}
+
+template <typename T>
+ssize_t Spool<T>::estimateRemaining(size_t pos) const {
+  const ssize_t buffered = dropped_ + rows_.size() - pos;
+  if (sourceDone_) {
+    return buffered;
+  }
+  const ssize_t rest = source_->estimateRemaining();
+  return rest < 0 ? -1 : buffered + rest;
+}
+
+template <typename T>
+folly::Future<folly::Unit> SpoolIterator<T>::prepare() {
+  if (this->prepared_) {
+    return folly::makeFuture();
+  }
+  return spool_->prepare().then([this]() { this->prepared_ = true; });
+}
+
+}
+}
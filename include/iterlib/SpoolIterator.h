@@ -0,0 +1,150 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <deque>
+#include <list>
+#include <memory>
+
+#include <folly/futures/SharedPromise.h>
+
+#include "iterlib/Iterator.h"
+
+namespace iterlib {
+namespace detail {
+
+template <typename T>
+class SpoolIterator;
+
+/**
+ * Runs a subtree once and hands out any number of cursors over its rows,
+ * for queries that use the same subtree in several places.
+ *
+ * Rows are buffered as the cursor furthest ahead pulls them from the
+ * source. In STREAMING mode a row is dropped once every cursor has moved
+ * past it, so cursors advancing in lock-step only buffer a few rows. All
+ * cursors must then be created before any of them advances. In
+ * MATERIALIZE mode every row is kept, cursors can be created at any time,
+ * are cacheable() and can be reset().
+ *
+ * Rows of sources with stableValues() are referenced, others are copied.
+ * Not thread safe, all cursors must be driven from the same thread.
+ *
+ * Cursors share ownership of the spool, so it must be owned by a
+ * std::shared_ptr and is only built through create().
+ */
+template <typename T=Item>
+class Spool : public std::enable_shared_from_this<Spool<T>> {
+ public:
+  enum class Mode { STREAMING, MATERIALIZE };
+
+  static std::shared_ptr<Spool> create(Iterator<T>* source,
+                                       Mode mode = Mode::STREAMING) {
+    return std::shared_ptr<Spool>(new Spool(source, mode));
+  }
+
+  // Throws std::logic_error in STREAMING mode once rows have been dropped
+  std::unique_ptr<SpoolIterator<T>> newCursor();
+
+  Mode mode() const { return mode_; }
+
+  // Number of rows currently held
+  size_t buffered() const { return rows_.size(); }
+
+ private:
+  friend class SpoolIterator<T>;
+  typedef typename std::list<size_t>::iterator Position;
+
+  Spool(Iterator<T>* source, Mode mode) : source_(source), mode_(mode) {}
+
+  // Prepares the source once, every cursor waits for the same result
+  folly::Future<folly::Unit> prepare();
+
+  // Row at *pos, pulling it from the source if needed, and moves *pos
+  // past it. nullptr once the source is exhausted.
+  const T* fetch(Position pos);
+
+  void release(Position pos);
+
+  // Drops the rows no cursor can return any more
+  void trim();
+
+  ssize_t estimateRemaining(size_t pos) const;
+
+  std::unique_ptr<Iterator<T>> source_;
+  const Mode mode_;
+  bool preparing_{false};
+  folly::SharedPromise<folly::Unit> prepared_;
+  bool sourceDone_{false};
+  // Index of the next row of each cursor
+  std::list<size_t> positions_;
+  // rows_[i] is row number dropped_ + i
+  std::deque<const T*> rows_;
+  // Backs rows_ when the source values are not stable
+  std::deque<T> copies_;
+  size_t dropped_{0};
+};
+
+// A cursor of a Spool, see Spool::newCursor()
+template <typename T=Item>
+class SpoolIterator : public Iterator<T> {
+ public:
+  ~SpoolIterator() override { spool_->release(pos_); }
+
+  const T& value() const override {
+    return current_ ? *current_ : T::kEmptyItem;
+  }
+
+  folly::Future<folly::Unit> prepare() override;
+
+  bool cacheable() const override {
+    return spool_->mode() == Spool<T>::Mode::MATERIALIZE;
+  }
+
+  // Materialized rows stay until the spool is destroyed
+  bool stableValues() const override { return cacheable(); }
+
+  ssize_t estimateRemaining() const override {
+    return this->done() ? 0 : spool_->estimateRemaining(*pos_);
+  }
+
+ protected:
+  bool doNext() override {
+    current_ = spool_->fetch(pos_);
+    return current_ != nullptr;
+  }
+
+  // Streamed rows may already be dropped
+  bool doReset() override {
+    if (!cacheable()) {
+      return false;
+    }
+    *pos_ = 0;
+    current_ = nullptr;
+    return true;
+  }
+
+ private:
+  friend class Spool<T>;
+
+  SpoolIterator(std::shared_ptr<Spool<T>> spool,
+                typename Spool<T>::Position pos)
+      : Iterator<T>(IteratorType::SPOOL),
+        spool_(std::move(spool)),
+        pos_(pos) {}
+
+  std::shared_ptr<Spool<T>> spool_;
+  typename Spool<T>::Position pos_;
+  const T* current_{nullptr};
+};
+
+}
+
+using Spool = detail::Spool<Item>;
+using SpoolIterator = detail::SpoolIterator<Item>;
+
+}
+
+#include "iterlib/SpoolIterator-inl.h"
@@ -0,0 +1,64 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <folly/Range.h>
+
+#include "iterlib/Predicate.h"
+
+namespace iterlib {
+
+/**
+ * PREFIX and CONTAINS matching of a fixed needle, one string at a time or
+ * over a column of strings.
+ *
+ * With SSE4.2 available, substring search scans 16 bytes per step with
+ * pcmpestri and only verifies candidate positions, and prefixes of up to 16
+ * bytes are checked with a single compare. Loads never read past the end
+ * of a string.
+ */
+class StringMatcher {
+ public:
+  // Throws std::invalid_argument unless type is PREFIX or CONTAINS
+  StringMatcher(std::string needle, FilterType type);
+
+  const std::string& needle() const { return needle_; }
+
+  bool match(folly::StringPiece s) const {
+    return type_ == FilterType::PREFIX ? startsWith(s) : contains(s);
+  }
+
+  // Appends the positions of the matching strings of column to *out and
+  // returns how many matched
+  size_t matchColumn(const std::vector<folly::StringPiece>& column,
+                     std::vector<uint32_t>* out) const;
+
+  // Same for a column held in a dynamic. The column type is checked once:
+  // std::vector<folly::StringPiece> takes the typed path above, other
+  // homogeneous non-string columns match nothing. Only vector_dynamic_t
+  // columns are classified per element, non-strings in them don't match.
+  size_t matchColumn(const dynamic& column, std::vector<uint32_t>* out) const;
+
+  // Position of the first occurrence of needle in s, or
+  // std::string::npos
+  size_t find(folly::StringPiece s) const;
+
+ private:
+  bool startsWith(folly::StringPiece s) const;
+
+  bool contains(folly::StringPiece s) const {
+    return find(s) != std::string::npos;
+  }
+
+  std::string needle_;
+  FilterType type_;
+  // First 16 bytes of needle, zero padded, for 16 byte aligned loads
+  alignas(16) char head_[16];
+};
+
+}
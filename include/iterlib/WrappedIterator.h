@@ -24,6 +24,8 @@ class WrappedIterator : public Iterator<T> {
 
   virtual bool orderPreserving() const { return false; }
 
+  Iterator<T>* getInnerIterator() const { return innerIter_.get(); }
+
  protected:
   std::unique_ptr<Iterator<T>> innerIter_;
 };
@@ -0,0 +1,125 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+//
+// Code to convert from/to a compact binary encoding
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <folly/Range.h>
+
+namespace iterlib { namespace variant {
+
+// Appends the encoding of v to out, see BinaryView for the format
+void toBinary(const dynamic& v, std::string* out);
+
+// Decodes a whole value. Strings point into data, which must outlive the
+// result. Containers nested deeper than maxDepth throw std::out_of_range
+// rather than risking the stack.
+dynamic fromBinary(folly::StringPiece data, size_t maxDepth = 100);
+
+/**
+ * Reads an encoded value without decoding it. Nested values are views of
+ * the same bytes, strings are returned as StringPieces into them and
+ * objects are looked up by binary search, so a reader only pays for the
+ * parts it touches.
+ *
+ * Every value starts with a tag byte:
+ *
+ *   kNull, kFalse, kTrue
+ *   kInt          zigzag varint
+ *   kDouble       8 bytes, little endian
+ *   kString       varint length, bytes
+ *   kIntVector    varint count, 8 bytes per int
+ *   kArray        varint count, uint32 payload size, count uint32 offsets
+ *                 of the elements in the payload, the payload
+ *   kStringVector kArray of kString values
+ *   kObject       kArray whose entries are a kString key followed by the
+ *                 value, sorted by key
+ *   kMap          same for the keys of an ordered_map_t, in its order
+ *
+ * Fixed size integers are little endian. Maps with string keys and views
+ * are written as kObject and read back as unordered_map_t.
+ *
+ * Reads past the end of the bytes throw std::out_of_range, accessors that
+ * don't match the tag throw std::logic_error.
+ */
+class BinaryView {
+ public:
+  enum Tag : uint8_t {
+    kNull = 0,
+    kFalse,
+    kTrue,
+    kInt,
+    kDouble,
+    kString,
+    kIntVector,
+    kArray,
+    kStringVector,
+    kObject,
+    kMap,
+  };
+
+  // A null value
+  BinaryView() : tag_(kNull) {}
+
+  // data starts with an encoded value, bytes after it are ignored
+  explicit BinaryView(folly::StringPiece data);
+
+  Tag tag() const { return tag_; }
+
+  bool isNull() const { return tag_ == kNull; }
+  bool isObject() const { return tag_ == kObject; }
+
+  bool asBool() const;
+  int64_t asInt() const;
+  double asDouble() const;
+  folly::StringPiece asString() const;
+
+  // Number of elements of a vector, or of entries of an object or map
+  size_t size() const;
+
+  // Element i of a kArray or kStringVector
+  BinaryView at(size_t i) const;
+
+  // Element i of a kIntVector
+  int64_t intAt(size_t i) const;
+
+  // Entry i of a kObject or kMap
+  BinaryView key(size_t i) const;
+  BinaryView value(size_t i) const;
+
+  // Sets *value to the value of key in an object. Returns false if the
+  // key is missing or this isn't an object.
+  bool find(folly::StringPiece key, BinaryView* value) const;
+
+  // See fromBinary()
+  dynamic decode(size_t maxDepth = 100) const;
+
+  // The encoded value
+  folly::StringPiece bytes() const { return data_; }
+
+ private:
+  void expect(bool matches) const;
+  void checkIndex(size_t i) const;
+  // Start and end of element or entry i of a container
+  folly::StringPiece element(size_t i) const;
+
+  folly::StringPiece data_;
+  Tag tag_;
+  // Containers only
+  size_t count_{0};
+  const char* offsets_{nullptr};
+  const char* payload_{nullptr};
+};
+
+inline std::string dynamic::toBinary() const {
+  std::string out;
+  iterlib::variant::toBinary(*this, &out);
+  return out;
+}
+
+}}
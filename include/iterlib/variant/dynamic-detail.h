@@ -9,7 +9,7 @@
 namespace iterlib { namespace variant {
 
 namespace detail {
-  struct less_visitor : boost::static_visitor<bool> {
+  struct less_visitor : static_visitor<bool> {
 
     // Find a way to make this less verbose using std::enable_if
     bool operator()(const int64_t& a, const int64_t& b) const {
@@ -96,14 +96,14 @@ namespace detail {
           return (aKeys[i] < bKeys[i]);
         }
         if (!(aValues[i] == bValues[i])) {
-          return boost::apply_visitor(*this, aValues[i], bValues[i]);
+          return apply_visitor(*this, aValues[i], bValues[i]);
         }
       }
       return false;
     }
 
     template <typename T, typename U>
-    bool operator() (T v1, U v2) const {
+    bool operator() (const T& v1, const U& v2) const {
       throw std::logic_error(
           folly::stringPrintf("Not supported '<' comparison: %s against %s",
                               typeid(v1).name(),
@@ -111,7 +111,7 @@ namespace detail {
     }
   };
 
-  struct equal_visitor : boost::static_visitor<bool> {
+  struct equal_visitor : static_visitor<bool> {
 
     template <typename T>
     bool operator()(const T& a, const T& b) const {
@@ -138,17 +138,64 @@ namespace detail {
       return (*a.first == *b.first) && (a.second == b.second);
     }
 
+    // Only reached for the same view, comparator_equal handles refs
+    bool operator()(const dynamic_ref& a, const dynamic_ref& b) const {
+      return a.target == b.target && a.renames == b.renames;
+    }
+
     template <typename T, typename U>
-    bool operator()(T v1, U v2) const {
+    bool operator()(const T& v1, const U& v2) const {
       return false;
     }
   };
 
+  // Scalars of the same type, the common case when sorting or joining,
+  // are compared with a single switch on the shared tag instead of the
+  // two of apply_visitor. Returns false for other pairs.
+  template <typename Compare>
+  bool compare_scalars(const dynamic& v1, const dynamic& v2, Compare cmp,
+                       bool* result) {
+    if (v1.which() != v2.which()) {
+      return false;
+    }
+    switch (v1.which()) {
+      case type_index<int64_t>::value:
+        *result = cmp(v1.getRef<int64_t>(), v2.getRef<int64_t>());
+        return true;
+      case type_index<double>::value:
+        *result = cmp(v1.getRef<double>(), v2.getRef<double>());
+        return true;
+      case type_index<folly::StringPiece>::value:
+        *result = cmp(v1.getRef<folly::StringPiece>(),
+                      v2.getRef<folly::StringPiece>());
+        return true;
+      case type_index<std::string>::value:
+        *result = cmp(v1.getRef<std::string>(), v2.getRef<std::string>());
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  // Compare v1 and v2 when at least one is a dynamic_ref. A view with
+  // renames compares like the ordered_map_t it stands for, see
+  // dynamic::resolve(), without copying its keys or values.
+  bool view_less(const dynamic& v1, const dynamic& v2);
+  bool view_equal(const dynamic& v1, const dynamic& v2);
+
+  // Views compare like the dynamic they stand for
   struct comparator_less {
     less_visitor visitor;
 
     bool operator() (const dynamic& v1, const dynamic& v2) const {
-      return boost::apply_visitor(visitor, v1, v2);
+      bool result;
+      if (compare_scalars(v1, v2, std::less<void>(), &result)) {
+        return result;
+      }
+      if (v1.is_of<dynamic_ref>() || v2.is_of<dynamic_ref>()) {
+        return view_less(v1, v2);
+      }
+      return apply_visitor(visitor, v1, v2);
     }
   };
 
@@ -156,11 +203,18 @@ namespace detail {
     equal_visitor visitor;
 
     bool operator() (const dynamic& v1, const dynamic& v2) const {
-      return boost::apply_visitor(visitor, v1, v2);
+      bool result;
+      if (compare_scalars(v1, v2, std::equal_to<void>(), &result)) {
+        return result;
+      }
+      if (v1.is_of<dynamic_ref>() || v2.is_of<dynamic_ref>()) {
+        return view_equal(v1, v2);
+      }
+      return apply_visitor(visitor, v1, v2);
     }
   };
 
-  struct append_visitor : boost::static_visitor<dynamic> {
+  struct append_visitor : static_visitor<dynamic> {
     dynamic operator()(const int64_t a, const int64_t b) const {
       return a + b;
     }
@@ -214,7 +268,7 @@ namespace detail {
    * For int and float number, it returns the product of two numbers
    * For vector of numbers, it computes the inner product of two vectors
    */
-  struct mul_visitor : boost::static_visitor<dynamic> {
+  struct mul_visitor : static_visitor<dynamic> {
     dynamic operator()(const int64_t a, const int64_t b) const {
       return a * b;
     }
@@ -260,12 +314,12 @@ namespace detail {
       if (!key.is_of<std::string>() && !key.is_of<folly::StringPiece>()) {
         throw std::out_of_range("Key not found");
       }
-      const auto it =
-          std::find(pair.first->begin(),
-                    pair.first->end(),
-                    (key.is_of<std::string>()
-                         ? key.getRef<std::string>()
-                         : key.get<folly::StringPiece>().toString()));
+      const folly::StringPiece name = key.is_of<std::string>()
+          ? folly::StringPiece(key.getRef<std::string>())
+          : key.get<folly::StringPiece>();
+      const auto it = std::find_if(
+          pair.first->begin(), pair.first->end(),
+          [name](const std::string& k) { return name == k; });
       if (it == pair.first->end()) {
         throw std::out_of_range("Key not found");
       }
@@ -273,7 +327,7 @@ namespace detail {
     }
   };
 
-  struct empty_visitor : boost::static_visitor<bool> {
+  struct empty_visitor : static_visitor<bool> {
     bool operator()(const boost::blank v) const {
       return true;
     }
@@ -316,17 +370,19 @@ namespace detail {
       // This is a map with keys in pair.first and values in pair.second
       return pair.second.empty();
     }
+
+    bool operator()(const dynamic_ref& ref) const;
   };
 
   struct dynamic_empty {
     empty_visitor visitor;
 
     bool operator() (const dynamic& v) const {
-      return boost::apply_visitor(visitor, v);
+      return apply_visitor(visitor, v);
     }
   };
 
-  struct length_visitor : boost::static_visitor<size_t> {
+  struct length_visitor : static_visitor<size_t> {
     size_t operator()(const boost::blank v) const {
       throw std::logic_error("length operator not supported for this type");
     }
@@ -368,13 +424,63 @@ namespace detail {
     size_t operator()(const vector_pair_t& pair) const {
       return pair.second.size();
     }
+
+    size_t operator()(const dynamic_ref& ref) const;
   };
 
   struct dynamic_length {
     length_visitor visitor;
 
     size_t operator() (const dynamic& v) const {
-      return boost::apply_visitor(visitor, v);
+      return apply_visitor(visitor, v);
+    }
+  };
+
+  // Heap bytes owned by a value, on top of sizeof(dynamic)
+  struct memory_visitor : static_visitor<size_t> {
+    template <typename T>
+    size_t operator()(const T& v) const {
+      return 0;
+    }
+
+    size_t operator()(const std::string& s) const {
+      return sizeof(s) + s.capacity();
+    }
+
+    size_t operator()(const vector_dynamic_t& vec) const {
+      size_t bytes = sizeof(vec) +
+                     (vec.capacity() - vec.size()) * sizeof(dynamic);
+      for (const auto& v : vec) {
+        bytes += v.memoryUsage();
+      }
+      return bytes;
+    }
+
+    template <typename T>
+    size_t operator()(const std::vector<T>& vec) const {
+      return sizeof(vec) + vec.capacity() * sizeof(T);
+    }
+
+    size_t operator()(const unordered_map_t& m) const {
+      // Each node also holds a next pointer and the hash
+      size_t bytes = sizeof(m) + m.bucket_count() * sizeof(void*);
+      for (const auto& kv : m) {
+        bytes += 2 * sizeof(void*) + sizeof(kv.first) +
+                 kv.first.capacity() + kv.second.memoryUsage();
+      }
+      return bytes;
+    }
+
+    size_t operator()(const ordered_map_t& m) const {
+      size_t bytes = sizeof(m);
+      for (const auto& kv : m) {
+        bytes += kv.first.memoryUsage() + kv.second.memoryUsage();
+      }
+      return bytes;
+    }
+
+    size_t operator()(const vector_pair_t& pair) const {
+      return operator()(pair.second) - sizeof(pair.second) + sizeof(pair);
     }
   };
 }
@@ -389,14 +495,14 @@ inline bool dynamic::operator==(const dynamic& other) const {
 
 inline dynamic& dynamic::operator+=(const dynamic& other) {
   detail::append_visitor visitor;
-  auto tmp = boost::apply_visitor(visitor, *this, other);
+  auto tmp = apply_visitor(visitor, *this, other);
   *this = std::move(tmp);
   return *this;
 }
 
 inline dynamic dynamic::operator*(const dynamic& other) const {
   detail::mul_visitor visitor;
-  return boost::apply_visitor(visitor, *this, other);
+  return apply_visitor(visitor, *this, other);
 }
 
 }}
@@ -11,7 +11,7 @@ namespace iterlib { namespace variant {
 
 folly::dynamic toFollyDynamic(const dynamic& v);
 
-struct FollyDynamicConverter : boost::static_visitor<folly::dynamic> {
+struct FollyDynamicConverter : static_visitor<folly::dynamic> {
 
   folly::dynamic operator() (const boost::blank v) const {
     return folly::dynamic::object;
@@ -36,7 +36,7 @@ struct FollyDynamicConverter : boost::static_visitor<folly::dynamic> {
   folly::dynamic operator() (const vector_dynamic_t& vec) const {
     folly::dynamic dyn = folly::dynamic::array;
     for (const auto& val : vec) {
-      dyn.push_back(boost::apply_visitor(*this, val));
+      dyn.push_back(apply_visitor(*this, val));
     }
     return dyn;
   }
@@ -53,7 +53,7 @@ struct FollyDynamicConverter : boost::static_visitor<folly::dynamic> {
   folly::dynamic operator() (const unordered_map_t& m) const {
     folly::dynamic dyn = folly::dynamic::object;
     for (const auto& kvp : m) {
-      dyn[kvp.first] = boost::apply_visitor(*this, kvp.second);
+      dyn[kvp.first] = apply_visitor(*this, kvp.second);
     }
     return dyn;
   }
@@ -66,7 +66,7 @@ struct FollyDynamicConverter : boost::static_visitor<folly::dynamic> {
       if (key.is_of<std::string>() || key.is_of<folly::StringPiece>()) {
         keyString = keyString.substr(1, keyString.size() - 2);
       }
-      dyn[keyString] = boost::apply_visitor(*this, kvp.second);
+      dyn[keyString] = apply_visitor(*this, kvp.second);
     }
     return dyn;
   }
@@ -78,14 +78,19 @@ struct FollyDynamicConverter : boost::static_visitor<folly::dynamic> {
     }
     folly::dynamic dyn = folly::dynamic::object;
     for (int i = 0; i < pair.second.size(); ++i) {
-      dyn[(*pair.first)[i]] = boost::apply_visitor(*this, pair.second[i]);
+      dyn[(*pair.first)[i]] = apply_visitor(*this, pair.second[i]);
     }
     return dyn;
   }
+
+  folly::dynamic operator() (const dynamic_ref& ref) const {
+    dynamic scratch;
+    return apply_visitor(*this, dynamic(ref).resolve(&scratch));
+  }
 };
 
 inline folly::dynamic toFollyDynamic(const dynamic& v) {
-  return boost::apply_visitor(FollyDynamicConverter(), v);
+  return apply_visitor(FollyDynamicConverter(), v);
 }
 
 inline dynamic::dynamic(const folly::dynamic f) {
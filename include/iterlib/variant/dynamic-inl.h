@@ -6,6 +6,16 @@
 
 namespace iterlib { namespace variant {
 
+namespace detail {
+// Holds a StringPiece key for lookups in maps keyed by std::string, its
+// buffer is reused so that lookups don't allocate
+inline const std::string& scratchKey(folly::StringPiece key) {
+  static thread_local std::string scratch;
+  scratch.assign(key.data(), key.size());
+  return scratch;
+}
+}
+
 template <typename T>
 inline const dynamic& dynamic::getItemRef(const dynamic& key) const {
   const T& container = this->getRef<T>();
@@ -13,7 +23,7 @@ inline const dynamic& dynamic::getItemRef(const dynamic& key) const {
     return static_cast<const dynamic&>(container.at(key.getRef<std::string>()));
   } else if (key.is_of<folly::StringPiece>()) {
     return static_cast<const dynamic&>(
-        container.at(key.get<folly::StringPiece>().toString()));
+        container.at(detail::scratchKey(key.get<folly::StringPiece>())));
   } else {
     throw std::out_of_range("Key not found");
   }
@@ -33,7 +43,7 @@ inline dynamic& dynamic::getNonConstItemRef(const dynamic& key) {
     return static_cast<dynamic&>(container.at(key.getRef<std::string>()));
   } else if (key.is_of<folly::StringPiece>()) {
     return static_cast<dynamic&>(
-        container.at(key.get<folly::StringPiece>().toString()));
+        container.at(detail::scratchKey(key.get<folly::StringPiece>())));
   } else {
     throw std::out_of_range("Key not found");
  }
@@ -74,8 +84,279 @@ inline size_t dynamic::length() const {
   return detail::dynamic_length()(*this);
 }
 
+inline size_t dynamic::memoryUsage() const {
+  return sizeof(dynamic) +
+         apply_visitor(detail::memory_visitor(), *this);
+}
+
+inline bool dynamic_ref::sourceKey(const dynamic& key,
+                                   const dynamic** source) const {
+  const dynamic* k = &key;
+  if (renames != nullptr) {
+    for (auto it = renames->rbegin(); it != renames->rend(); ++it) {
+      if (*k == it->second) {
+        k = &it->first;
+      } else if (*k == it->first) {
+        // Renamed away
+        return false;
+      }
+    }
+  }
+  *source = k;
+  return true;
+}
+
+inline bool dynamic_ref::viewKey(const dynamic& key,
+                                 const dynamic** viewed) const {
+  const dynamic* k = &key;
+  if (renames != nullptr) {
+    for (const auto& rename : *renames) {
+      if (*k == rename.first) {
+        k = &rename.second;
+      } else if (*k == rename.second) {
+        // Shadowed by a renamed key
+        return false;
+      }
+    }
+  }
+  *viewed = k;
+  return true;
+}
+
+inline const dynamic& dynamic::resolve(dynamic* scratch) const {
+  if (!this->is_of<dynamic_ref>()) {
+    return *this;
+  }
+  const dynamic_ref& ref = this->getRef<dynamic_ref>();
+  if (ref.renames == nullptr || !ref.target->isObject()) {
+    return *ref.target;
+  }
+  ordered_map_t m;
+  for (const auto& kv : *this) {
+    m.insert({kv.first, kv.second.get()});
+  }
+  *scratch = std::move(m);
+  return *scratch;
+}
+
+namespace detail {
+
+// An entry of a view or of an ordered_map_t. String keys of other maps are
+// kept as a name with a null key, so collecting entries copies nothing.
+struct view_entry {
+  const dynamic* key;
+  folly::StringPiece name;
+  const dynamic* value;
+};
+
+template <typename Compare>
+inline bool compare_view_keys(const view_entry& a, const view_entry& b,
+                              Compare cmp) {
+  if (a.key == nullptr && b.key == nullptr) {
+    return cmp(a.name, b.name);
+  }
+  if (a.key != nullptr && b.key != nullptr) {
+    return cmp(*a.key, *b.key);
+  }
+  // A dynamic StringPiece doesn't allocate
+  return a.key != nullptr ? cmp(*a.key, dynamic(b.name))
+                          : cmp(dynamic(a.name), *b.key);
+}
+
+// The entries of an ordered_map_t or of a view with renames, in key order
+class view_entries {
+ public:
+  explicit view_entries(const dynamic& v) {
+    if (v.is_of<ordered_map_t>()) {
+      for (const auto& kv : v.getRef<ordered_map_t>()) {
+        add(&kv.first, folly::StringPiece(), &kv.second);
+      }
+      return;
+    }
+    const dynamic_ref& ref = v.getRef<dynamic_ref>();
+    const dynamic& target = *ref.target;
+    if (target.is_of<unordered_map_t>()) {
+      for (const auto& kv : target.getRef<unordered_map_t>()) {
+        addNamed(ref, kv.first, &kv.second);
+      }
+    } else if (target.is_of<vector_pair_t>()) {
+      const auto& pair = target.getRef<vector_pair_t>();
+      for (size_t i = 0; i < pair.second.size(); i++) {
+        addNamed(ref, (*pair.first)[i], &pair.second[i]);
+      }
+    } else if (target.is_of<ordered_map_t>()) {
+      for (const auto& kv : target.getRef<ordered_map_t>()) {
+        const dynamic* viewed;
+        if (ref.viewKey(kv.first, &viewed)) {
+          add(viewed, folly::StringPiece(), &kv.second);
+        }
+      }
+    } else {
+      // Not reached for well formed views, see dynamic_ref
+      const dynamic& resolved = v.resolve(&scratch_);
+      for (const auto& kv : resolved.getRef<ordered_map_t>()) {
+        add(&kv.first, folly::StringPiece(), &kv.second);
+      }
+      return;
+    }
+    std::sort(data(), data() + size_, [](const view_entry& a,
+                                         const view_entry& b) {
+      return compare_view_keys(a, b, std::less<void>());
+    });
+  }
+
+  view_entries(const view_entries&) = delete;
+  view_entries& operator=(const view_entries&) = delete;
+
+  size_t size() const { return size_; }
+  const view_entry& operator[](size_t i) const { return data()[i]; }
+
+ private:
+  static constexpr size_t kInline = 16;
+
+  view_entry* data() { return heap_.empty() ? inline_ : heap_.data(); }
+  const view_entry* data() const {
+    return heap_.empty() ? inline_ : heap_.data();
+  }
+
+  void addNamed(const dynamic_ref& ref, const std::string& name,
+                const dynamic* value) {
+    const dynamic key{folly::StringPiece(name)};
+    const dynamic* viewed;
+    if (!ref.viewKey(key, &viewed)) {
+      return;
+    }
+    if (viewed == &key) {
+      add(nullptr, name, value);
+    } else {
+      add(viewed, folly::StringPiece(), value);
+    }
+  }
+
+  void add(const dynamic* key, folly::StringPiece name, const dynamic* value) {
+    if (size_ < kInline) {
+      inline_[size_++] = view_entry{key, name, value};
+      return;
+    }
+    if (heap_.empty()) {
+      heap_.assign(inline_, inline_ + kInline);
+    }
+    heap_.push_back(view_entry{key, name, value});
+    size_++;
+  }
+
+  view_entry inline_[kInline];
+  std::vector<view_entry> heap_;
+  size_t size_{0};
+  dynamic scratch_;
+};
+
+// The dynamic a view stands for when it has no renames, or v itself
+inline const dynamic& unwrap_view(const dynamic& v) {
+  const dynamic* d = &v;
+  while (d->is_of<dynamic_ref>()) {
+    const dynamic_ref& ref = d->getRef<dynamic_ref>();
+    if (ref.renames != nullptr && ref.target->isObject()) {
+      break;
+    }
+    d = ref.target;
+  }
+  return *d;
+}
+
+inline bool same_view(const dynamic& a, const dynamic& b) {
+  return a.is_of<dynamic_ref>() && b.is_of<dynamic_ref>() &&
+         a.getRef<dynamic_ref>().target == b.getRef<dynamic_ref>().target &&
+         a.getRef<dynamic_ref>().renames == b.getRef<dynamic_ref>().renames;
+}
+
+inline bool view_less(const dynamic& v1, const dynamic& v2) {
+  const dynamic& a = unwrap_view(v1);
+  const dynamic& b = unwrap_view(v2);
+  if (!a.is_of<dynamic_ref>() && !b.is_of<dynamic_ref>()) {
+    return a < b;
+  }
+  if (same_view(a, b)) {
+    return false;
+  }
+  if (!(a.is_of<dynamic_ref>() || a.is_of<ordered_map_t>()) ||
+      !(b.is_of<dynamic_ref>() || b.is_of<ordered_map_t>())) {
+    throw std::logic_error("Not supported '<' comparison");
+  }
+  const view_entries x(a);
+  const view_entries y(b);
+  const size_t n = std::min(x.size(), y.size());
+  for (size_t i = 0; i < n; i++) {
+    if (compare_view_keys(x[i], y[i], std::less<void>())) {
+      return true;
+    }
+    if (compare_view_keys(y[i], x[i], std::less<void>())) {
+      return false;
+    }
+    if (*x[i].value < *y[i].value) {
+      return true;
+    }
+    if (*y[i].value < *x[i].value) {
+      return false;
+    }
+  }
+  return x.size() < y.size();
+}
+
+inline bool view_equal(const dynamic& v1, const dynamic& v2) {
+  const dynamic& a = unwrap_view(v1);
+  const dynamic& b = unwrap_view(v2);
+  if (!a.is_of<dynamic_ref>() && !b.is_of<dynamic_ref>()) {
+    return a == b;
+  }
+  if (same_view(a, b)) {
+    return true;
+  }
+  if (!(a.is_of<dynamic_ref>() || a.is_of<ordered_map_t>()) ||
+      !(b.is_of<dynamic_ref>() || b.is_of<ordered_map_t>())) {
+    return false;
+  }
+  const view_entries x(a);
+  const view_entries y(b);
+  if (x.size() != y.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < x.size(); i++) {
+    if (!compare_view_keys(x[i], y[i], std::equal_to<void>()) ||
+        !(*x[i].value == *y[i].value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool empty_visitor::operator()(const dynamic_ref& ref) const {
+  if (ref.renames == nullptr || !ref.target->isObject()) {
+    return ref.target->empty();
+  }
+  const dynamic view = ref;
+  return view.begin() == view.end();
+}
+
+inline size_t length_visitor::operator()(const dynamic_ref& ref) const {
+  if (ref.renames == nullptr || !ref.target->isObject()) {
+    return ref.target->length();
+  }
+  const dynamic view = ref;
+  return std::distance(view.begin(), view.end());
+}
+
+}
+
 inline const dynamic& dynamic::at(const dynamic& key) const {
-  if (this->is_of<unordered_map_t>()) {
+  if (this->is_of<dynamic_ref>()) {
+    const dynamic_ref& ref = this->getRef<dynamic_ref>();
+    const dynamic* source;
+    if (!ref.sourceKey(key, &source)) {
+      throw std::out_of_range("Key not found");
+    }
+    return ref.target->at(*source);
+  } else if (this->is_of<unordered_map_t>()) {
     return this->getItemRef<unordered_map_t>(key);
   } else if (this->is_of<ordered_map_t>()) {
     return this->getItemRef<ordered_map_t>(key);
@@ -95,7 +376,9 @@ inline const dynamic& dynamic::at(const dynamic& key) const {
 }
 
 inline dynamic& dynamic::at(const dynamic& key) {
-  if (this->is_of<unordered_map_t>()) {
+  if (this->is_of<dynamic_ref>()) {
+    throw std::logic_error("dynamic_ref is read-only");
+  } else if (this->is_of<unordered_map_t>()) {
     return this->getNonConstItemRef<unordered_map_t>(key);
   } else if (this->is_of<ordered_map_t>()) {
     return this->getNonConstItemRef<ordered_map_t>(key);
@@ -113,6 +396,46 @@ inline dynamic& dynamic::at(const dynamic& key) {
   }
 }
 
+inline const dynamic* dynamic::find(folly::StringPiece name) const {
+  if (this->is_of<unordered_map_t>()) {
+    const auto& m = this->getRef<unordered_map_t>();
+    const auto it = m.find(detail::scratchKey(name));
+    return it == m.end() ? nullptr : &it->second;
+  } else if (this->is_of<vector_pair_t>()) {
+    const auto& pair = this->getRef<vector_pair_t>();
+    if (pair.first == nullptr) {
+      return nullptr;
+    }
+    const size_t pos =
+        std::find_if(pair.first->begin(), pair.first->end(),
+                     [name](const std::string& k) { return name == k; }) -
+        pair.first->begin();
+    return pos < pair.second.size() ? &pair.second[pos] : nullptr;
+  } else if (this->is_of<ordered_map_t>()) {
+    const auto& m = this->getRef<ordered_map_t>();
+    try {
+      const auto it = m.find(dynamic(name));
+      return it == m.end() ? nullptr : &it->second;
+    } catch (const std::exception&) {
+      // Keys that don't compare with strings
+      return nullptr;
+    }
+  } else if (this->is_of<dynamic_ref>()) {
+    const dynamic_ref& ref = this->getRef<dynamic_ref>();
+    if (ref.renames == nullptr) {
+      return ref.target->find(name);
+    }
+    const dynamic viewed = name;
+    const dynamic* source;
+    if (!ref.sourceKey(viewed, &source)) {
+      return nullptr;
+    }
+    const dynamic& v = ref.target->atNoThrow(*source);
+    return &v == &kNullDynamic ? nullptr : &v;
+  }
+  return nullptr;
+}
+
 inline dynamic& dynamic::atWithInsert(const dynamic& key) {
   if (this->is_of<unordered_map_t>()) {
     return this->getNonConstItemRefWithInsert<unordered_map_t>(key);
@@ -8,6 +8,8 @@
 // (Note that it returns you copy of a key,
 // but a reference_wrapper to the actual value).
 // Keep in sync with isIterable() function!
+// A dynamic_ref iterates its target, with keys mapped through its renames
+// and hidden keys skipped.
 #pragma once
 
 namespace iterlib { namespace variant {
@@ -26,12 +28,71 @@ class dynamic_iterator
 
   // The end() iterator
   dynamic_iterator() : index_(0), values_(nullptr), max_(0), type_(UNKNOWN),
-                       current_(kNullDynamic, kNullDynamic) {}
+                       current_(kNullDynamic, kNullDynamic),
+                       ref_{nullptr, nullptr} {}
 
   // The begin iterator is initialized based on the underlying type
   explicit dynamic_iterator(const dynamic* value) :
       index_(0),
-      current_(kNullDynamic, kNullDynamic) {
+      current_(kNullDynamic, kNullDynamic),
+      ref_{nullptr, nullptr} {
+    if (value != nullptr && value->is_of<dynamic_ref>()) {
+      ref_ = value->getRef<dynamic_ref>();
+      value = ref_.target;
+    }
+    init(value);
+    settle();
+  }
+
+  // Iterator increments differently based on the underlying type
+  // When all items are done, the iterator state will match that of
+  // dynamic_iterator()
+  const dynamic_iterator& operator++() {
+    advance();
+    settle();
+    return *this;
+  }
+
+  // Iterators will be considered equal when they point to the same dynamic
+  // and are at the same index of iteration
+  bool operator==(dynamic_iterator const& other) const {
+    return ((values_ == other.values_) && (index_ == other.index_));
+  }
+
+  bool operator!=(dynamic_iterator const& other) const {
+    return !(*this == other);
+  }
+
+  const dynamic& getKey() {
+    return static_cast<const dynamic&>(current_.first);
+  }
+
+  const dynamic& getValue() {
+    return static_cast<const dynamic&>(current_.second.get());
+  }
+
+  // dereferencing the iterator returns you your own copy
+  // of DynIterValue - copy of the key, and reference_wrapper of the value
+  DynIterValue operator*() const {
+    if (values_ && ref_.renames != nullptr) {
+      // settle() stored the renamed key
+      return current_;
+    }
+    return DynIterValue(sourceKey(), current_.second);
+  }
+
+  DynIterValue* operator->() {
+    current_ = operator*();
+    return &current_;
+  }
+
+  const DynIterValue* operator->() const {
+    current_ = operator*();
+    return &current_;
+  }
+
+ private:
+  void init(const dynamic* value) {
     values_ = value;
     if (values_ == nullptr) {
       max_ = 0;
@@ -82,10 +143,7 @@ class dynamic_iterator
     }
   }
 
-  // Iterator increments differently based on the underlying type
-  // When all items are done, the iterator state will match that of
-  // dynamic_iterator()
-  const dynamic_iterator& operator++() {
+  void advance() {
     if (!values_) {
       throw std::out_of_range("Cannot increment past end");
     }
@@ -95,7 +153,7 @@ class dynamic_iterator
       if (index_ >= max_) {
         values_ = nullptr;
         index_ = 0;
-        return *this;
+        return;
       }
       auto& pair = values_->getRef<vector_pair_t>();
       current_.first = pair.first->at(index_);
@@ -128,7 +186,7 @@ class dynamic_iterator
       if (index_ >= max_) {
         values_ = nullptr;
         index_ = 0;
-        return *this;
+        return;
       }
       current_.second = std::ref(values_->getRef<vector_dynamic_t>()[index_]);
       break;
@@ -139,46 +197,20 @@ class dynamic_iterator
       throw std::logic_error(what);
     }
     } // Switch
-    return *this;
-  }
-
-  // Iterators will be considered equal when they point to the same dynamic
-  // and are at the same index of iteration
-  bool operator==(dynamic_iterator const& other) const {
-    return ((values_ == other.values_) && (index_ == other.index_));
-  }
-
-  bool operator!=(dynamic_iterator const& other) const {
-    return !(*this == other);
-  }
-
-  const dynamic& getKey() {
-    return static_cast<const dynamic&>(current_.first);
-  }
-
-  const dynamic& getValue() {
-    return static_cast<const dynamic&>(current_.second.get());
   }
 
-  // dereferencing the iterator returns you your own copy
-  // of DynIterValue - copy of the key, and reference_wrapper of the value
-  DynIterValue operator*() const {
+  // The key of the current element of the iterated dynamic
+  dynamic sourceKey() const {
     if (values_) {
       switch (type_) {
         case VECTOR_PAIR:
-          return DynIterValue(
-            values_->getRef<vector_pair_t>().first->at(index_),
-            current_.second
-          );
+          return values_->getRef<vector_pair_t>().first->at(index_);
         case UNORDERED_MAP:
-          return DynIterValue((*mIter_).first,
-                              current_.second);
+          return (*mIter_).first;
         case ORDERED_MAP:
-          return DynIterValue((*omIter_).first,
-                              current_.second);
+          return (*omIter_).first;
         case VECTOR_DYNAMIC:
-          return DynIterValue(static_cast<int64_t>(index_),
-                              current_.second);
+          return static_cast<int64_t>(index_);
         default: {
           const auto& what = folly::stringPrintf(
               "Iteration not supported for dynamic type: %d", values_->which());
@@ -190,15 +222,23 @@ class dynamic_iterator
     }
   }
 
-  DynIterValue* operator->() {
-    current_ = operator*();
-    return &current_;
+  // For views with renames, skips hidden elements and renames the key of
+  // the current one
+  void settle() {
+    if (ref_.renames == nullptr) {
+      return;
+    }
+    while (values_) {
+      const dynamic key = sourceKey();
+      const dynamic* viewed;
+      if (ref_.viewKey(key, &viewed)) {
+        current_.first = *viewed;
+        return;
+      }
+      advance();
+    }
   }
 
-  const DynIterValue* operator->() const {
-    current_ = operator*();
-    return &current_;
-  }
  private:
   uint64_t index_;
   const dynamic* values_;
@@ -207,6 +247,7 @@ class dynamic_iterator
   ordered_map_t::const_iterator omIter_;
   ItType type_;
   mutable DynIterValue current_;
+  dynamic_ref ref_;
 };
 
 }}
@@ -3,16 +3,19 @@
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
 //
-// Code to convert to json
+// Code to convert from/to json
 #pragma once
 
+#include <deque>
+#include <unordered_map>
+
 #include <folly/json.h>
 
 namespace iterlib { namespace variant {
 
 std::string toJson(const dynamic& v);
 
-struct JsonPrinter : public boost::static_visitor<> {
+struct JsonPrinter : public static_visitor<> {
   explicit JsonPrinter(std::ostream& out) : out_(out) {}
   virtual ~JsonPrinter() {}
 
@@ -45,7 +48,7 @@ struct JsonPrinter : public boost::static_visitor<> {
       } else {
         separator();
       }
-      boost::apply_visitor(*this, v);
+      apply_visitor(*this, v);
     }
     vectorEnd();
   }
@@ -120,6 +123,27 @@ struct JsonPrinter : public boost::static_visitor<> {
     mapEnd();
   }
 
+  void operator() (const dynamic_ref& ref) const {
+    if (ref.renames == nullptr || !ref.target->isObject()) {
+      apply_visitor(*this, *ref.target);
+      return;
+    }
+    const dynamic view = ref;
+    mapBegin();
+    bool first = true;
+    for (const auto& item : view) {
+      if (first) {
+        first = false;
+      } else {
+        separator();
+      }
+      orderedMapKey(item.first);
+      keyValueSeparator();
+      orderedMapValue(item.second);
+    }
+    mapEnd();
+  }
+
 protected:
   virtual void printString(const folly::StringPiece v) const {
     std::string escaped;
@@ -159,15 +183,15 @@ protected:
   }
 
   void unorderedMapValue(const dynamic& value) const {
-      boost::apply_visitor(*this, value);
+      apply_visitor(*this, value);
   }
 
   virtual void orderedMapKey(const dynamic& key) const {
-      boost::apply_visitor(*this, key);
+      apply_visitor(*this, key);
   }
 
   void orderedMapValue(const dynamic& value) const {
-      boost::apply_visitor(*this, value);
+      apply_visitor(*this, value);
   }
 
   std::ostream& out_;
@@ -175,7 +199,7 @@ protected:
 
 inline std::string toJson(const dynamic& v) {
   std::stringstream json;
-  boost::apply_visitor(JsonPrinter(json), v);
+  apply_visitor(JsonPrinter(json), v);
   return json.str();
 }
 
@@ -184,8 +208,43 @@ inline std::string dynamic::toJson() const {
 }
 
 inline std::ostream& operator<<(std::ostream& out, const dynamic& v) {
-  boost::apply_visitor(JsonPrinter(out), v);
+  apply_visitor(JsonPrinter(out), v);
   return out;
 }
 
+/**
+ * Key vectors of the vector_pair_t objects built by fromJson(), one per
+ * distinct sequence of keys, so objects of the same shape share theirs.
+ * Must outlive the values parsed with it.
+ */
+class JsonShapes {
+ public:
+  // The key vector equal to keys, added if there is none yet
+  const std::vector<std::string>* intern(
+      const std::vector<folly::StringPiece>& keys);
+
+  size_t size() const { return shapes_.size(); }
+
+ private:
+  std::deque<std::vector<std::string>> shapes_;
+  std::unordered_multimap<uint64_t, const std::vector<std::string>*> index_;
+};
+
+struct JsonParseOptions {
+  // Strings without escapes are StringPieces into the input, which must
+  // then outlive the result
+  bool borrowStrings{false};
+  // Objects become vector_pair_t with keys from shapes instead of
+  // unordered_map_t
+  JsonShapes* shapes{nullptr};
+  // Deeper nesting is rejected rather than risking the stack
+  size_t maxDepth{100};
+};
+
+// Parses json straight into a dynamic, without going through
+// folly::dynamic. Integers that don't fit in an int64_t become doubles.
+// Throws std::runtime_error on malformed input.
+dynamic fromJson(folly::StringPiece json,
+                 const JsonParseOptions& options = JsonParseOptions());
+
 }}
@@ -5,17 +5,25 @@
 
 #pragma once
 
-#include <boost/variant.hpp>
 #include <boost/blank.hpp>
-#include <boost/variant/recursive_variant.hpp>
+#include <boost/variant/get.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <map>
+#include <new>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include <type_traits>
 #include <folly/dynamic.h>
 #include <folly/sorted_vector_types.h>
 #include <folly/String.h>
 
+
 namespace iterlib { namespace variant {
 
 struct dynamic;
@@ -25,46 +33,197 @@ typedef folly::sorted_vector_map<dynamic, dynamic> ordered_map_t;
 typedef std::unordered_map<std::string, dynamic> unordered_map_t;
 typedef std::pair<const std::vector<std::string>*, std::vector<dynamic>>
   vector_pair_t;
+// (old key, new key) pairs, see dynamic_ref
+typedef std::vector<std::pair<dynamic, dynamic>> rename_vec_t;
+
+// A read-only view of another dynamic, optionally with some of its keys
+// renamed. Lookups, iteration, comparison and JSON output behave as if the
+// renames had been applied to a copy of target. Renames are applied in
+// order, a key renamed onto an existing key hides that key.
+//
+// Neither pointer is owned, both must outlive the view and any copy of it.
+// target must not be a dynamic_ref itself, copy the ref instead.
+struct dynamic_ref {
+  const dynamic* target;
+  const rename_vec_t* renames;
+
+  // Sets *source to the key of target that key of the view maps to.
+  // Returns false if the view hides key.
+  bool sourceKey(const dynamic& key, const dynamic** source) const;
+
+  // Sets *viewed to the key of the view that key of target maps to.
+  // Returns false if the view hides key.
+  bool viewKey(const dynamic& key, const dynamic** viewed) const;
+};
+
+namespace detail {
+template <typename... Ts>
+struct type_list {};
 
+// The types a dynamic can hold, in which() order.
 // Add a corresponding test to make sure the which() is consistent.
-typedef boost::variant<
+typedef type_list<
           boost::blank,
           bool,
           int64_t,
           double,
           folly::StringPiece,
           std::string,                                                     // 5
-          boost::recursive_wrapper<vector_dynamic_t>,
+          vector_dynamic_t,
           std::vector<int64_t>,
           std::vector<folly::StringPiece>,
-          boost::recursive_wrapper<unordered_map_t>,
-          boost::recursive_wrapper<ordered_map_t>,
-          boost::recursive_wrapper<vector_pair_t>
-          > dynamic_variant;
+          unordered_map_t,
+          ordered_map_t,
+          vector_pair_t,
+          dynamic_ref
+          > dynamic_types;
+
+template <typename T, typename List>
+struct index_of;
+
+template <typename T>
+struct index_of<T, type_list<>> {
+  static constexpr int value = -1;
+};
+
+template <typename T, typename... Ts>
+struct index_of<T, type_list<T, Ts...>> {
+  static constexpr int value = 0;
+};
+
+template <typename T, typename U, typename... Ts>
+struct index_of<T, type_list<U, Ts...>> {
+  static constexpr int rest = index_of<T, type_list<Ts...>>::value;
+  static constexpr int value = rest < 0 ? -1 : rest + 1;
+};
+
+// which() of the dynamics holding a T, -1 if T is not one of the types
+template <typename T>
+struct type_index {
+  static constexpr int value = index_of<T, dynamic_types>::value;
+};
+
+// Types that don't fit the 16 bytes a dynamic keeps inline are held
+// through a pointer to a heap copy
+template <typename T>
+struct is_boxed : std::false_type {};
+template <>
+struct is_boxed<std::string> : std::true_type {};
+template <>
+struct is_boxed<vector_dynamic_t> : std::true_type {};
+template <>
+struct is_boxed<std::vector<int64_t>> : std::true_type {};
+template <>
+struct is_boxed<std::vector<folly::StringPiece>> : std::true_type {};
+template <>
+struct is_boxed<unordered_map_t> : std::true_type {};
+template <>
+struct is_boxed<ordered_map_t> : std::true_type {};
+template <>
+struct is_boxed<vector_pair_t> : std::true_type {};
+
+// Bit i is set if the type with which() i is boxed
+template <typename List>
+struct boxed_mask;
+
+template <>
+struct boxed_mask<type_list<>> {
+  static constexpr uint32_t value = 0;
+};
+
+template <typename T, typename... Ts>
+struct boxed_mask<type_list<T, Ts...>> {
+  static constexpr uint32_t value =
+      (boxed_mask<type_list<Ts...>>::value << 1) | is_boxed<T>::value;
+};
+
+// How a T is constructed, accessed and destroyed in the storage of a
+// dynamic. Inline types are trivially copyable, so moving a dynamic is a
+// copy of its bytes.
+template <typename T, bool = is_boxed<T>::value>
+struct slot {
+  template <typename U>
+  static void construct(void* p, U&& v) {
+    new (p) T(std::forward<U>(v));
+  }
+
+  static T& get(void* p) { return *static_cast<T*>(p); }
+  static const T& get(const void* p) { return *static_cast<const T*>(p); }
+
+  static void destroy(void* p) {}
+};
+
+template <typename T>
+struct slot<T, true> {
+  template <typename U>
+  static void construct(void* p, U&& v) {
+    *static_cast<T**>(p) = new T(std::forward<U>(v));
+  }
+
+  static T& get(void* p) { return **static_cast<T**>(p); }
+  static const T& get(const void* p) {
+    return **static_cast<T* const*>(p);
+  }
+
+  static void destroy(void* p) { delete *static_cast<T**>(p); }
+};
+}
 
-class dynamic : public dynamic_variant {
+// A tagged union of the types in detail::dynamic_types. Scalars, string
+// pieces and views are stored inline, the other types are boxed. Values
+// are dispatched on with a switch over the one byte tag, see visit().
+class dynamic {
 public:
-  using dynamic_variant::operator=;
-  using dynamic_variant::operator==;
+  dynamic(const dynamic& d);
+  // Inline values are copied, boxed ones are taken and d is left blank
+  dynamic(dynamic&& d) noexcept : tag_(d.tag_) {
+    std::memcpy(storage_, d.storage_, sizeof(storage_));
+    if (d.boxed()) {
+      d.tag_ = 0;
+    }
+  }
+  ~dynamic() {
+    if (boxed()) {
+      destroy();
+    }
+  }
 
-  dynamic(const dynamic& d) = default;
-  dynamic& operator=(const dynamic& d) = default;
-  dynamic& operator=(dynamic&& d) = default;
+  dynamic& operator=(const dynamic& d) {
+    dynamic tmp(d);
+    swap(tmp);
+    return *this;
+  }
+
+  // The old value is destroyed after d is moved in, d may be part of it
+  dynamic& operator=(dynamic&& d) noexcept {
+    if (!boxed()) {
+      std::memcpy(storage_, d.storage_, sizeof(storage_));
+      tag_ = d.tag_;
+      if (d.boxed()) {
+        d.tag_ = 0;
+      }
+      return *this;
+    }
+    dynamic tmp(std::move(d));
+    swap(tmp);
+    return *this;
+  }
 
   static const dynamic kNullDynamic;
 
   // Constructors
-  dynamic() : dynamic_variant() {}
+  dynamic() {}
   /* implicit */ dynamic(folly::dynamic f);
 
   // Explicit conversions for things that the compiler has trouble
   // converting implicitly
   //
   // int32_t
-  /* implicit */ dynamic(int32_t v) : dynamic_variant(int64_t(v)) {}
+  /* implicit */ dynamic(int32_t v) { construct(int64_t(v)); }
   // string literals
-  /* implicit */ dynamic(const char * const v)
-    : dynamic_variant(std::string(v)) {}
+  /* implicit */ dynamic(const char * const v) {
+    construct(std::string(v));
+  }
 
   // Do not use as a copy constructor
   template<typename T, class = typename std::enable_if<
@@ -73,35 +232,68 @@ public:
       && !std::is_same<T, dynamic &>::value
       && !std::is_base_of<dynamic, T>::value
     >::type>
-  /* implicit */ dynamic(const T& v) : dynamic_variant(v) {}
+  /* implicit */ dynamic(const T& v) { construct(v); }
 
   // Do not use as a copy constructor
   template<typename T, class = typename std::enable_if<
       !std::is_same<T, const dynamic>::value
       && !std::is_same<T, dynamic>::value
       && !std::is_same<T, dynamic &>::value
-      && !std::is_base_of<dynamic, T>::value
+      && !std::is_base_of<dynamic, typename std::decay<T>::type>::value
+    >::type>
+  /* implicit */ dynamic(T&& v) { construct(std::forward<T>(v)); }
+
+  template<typename T, class = typename std::enable_if<
+      !std::is_base_of<dynamic, typename std::decay<T>::type>::value
     >::type>
-  /* implicit */ dynamic(T&& v) : dynamic_variant(std::forward<T>(v)) {}
+  dynamic& operator=(T&& v) {
+    dynamic tmp(std::forward<T>(v));
+    swap(tmp);
+    return *this;
+  }
+
+  void swap(dynamic& other) noexcept {
+    std::swap(tag_, other.tag_);
+    std::swap(storage_, other.storage_);
+  }
+
+  // Index of the held type in detail::dynamic_types
+  int which() const { return tag_; }
+
+  const std::type_info& type() const;
 
+  // Calls f with a reference to the held value, f must accept all of
+  // the types. Returns what f returns, which must not depend on the type.
+  template <typename F>
+  decltype(auto) visit(F&& f) const;
+  template <typename F>
+  decltype(auto) visit(F&& f);
+
+  // Compares which() rather than type(), so it costs an int comparison
+  // instead of a type_info one
   template <typename T>
-  bool is_of() const { return type() == typeid(T); }
+  bool is_of() const { return which() == detail::type_index<T>::value; }
 
-  // So we don't have to use boost::get<> all over
-  // the code base
+  // These throw boost::bad_get if the dynamic doesn't hold a T
   template <typename T>
   T get() const {
-    return boost::get<T>(*this);
+    return getRef<T>();
   }
 
   template <typename T>
   const T& getRef() const {
-    return boost::get<const T&>(*this);
+    if (!is_of<T>()) {
+      throw boost::bad_get();
+    }
+    return detail::slot<T>::get(storage_);
   }
 
   template <typename T>
   T& getNonConstRef() {
-    return boost::get<T&>(*this);
+    if (!is_of<T>()) {
+      throw boost::bad_get();
+    }
+    return detail::slot<T>::get(storage_);
   }
 
   dynamic& operator=(const char* const v) {
@@ -213,8 +405,16 @@ public:
     return length();
   }
 
+  // Approximate number of bytes used by this value, including the heap
+  // memory it owns. StringPieces, views and the shared keys of a
+  // vector_pair_t don't own what they point to.
+  size_t memoryUsage() const;
+
   std::string toJson() const;
 
+  // See BinaryView for the format
+  std::string toBinary() const;
+
   // If this dynamic is a primitive type, return a string representation.
   // If its a complex type (map or vector) return the json representation.
   std::string toString() const {
@@ -253,12 +453,18 @@ public:
   // True if the underlying dynamic type is a map type
   // (supports key value pairs), false otherwise
   bool isObject() const {
+    if (this->is_of<dynamic_ref>()) {
+      return this->getRef<dynamic_ref>().target->isObject();
+    }
     return (this->is_of<vector_pair_t>() || this->is_of<unordered_map_t>() ||
             this->is_of<ordered_map_t>());
   }
 
   // True if the underlying dynamic type is an array type, false otherwise
   bool isArray() const {
+    if (this->is_of<dynamic_ref>()) {
+      return this->getRef<dynamic_ref>().target->isArray();
+    }
     return (this->is_of<vector_dynamic_t>() ||
             this->is_of<std::vector<int64_t>>() ||
             this->is_of<std::vector<folly::StringPiece>>());
@@ -266,9 +472,16 @@ public:
 
   // Keep in sync with dynamic_iterator
   bool isIterable() const {
+    if (this->is_of<dynamic_ref>()) {
+      return this->getRef<dynamic_ref>().target->isIterable();
+    }
     return isObject() || this->is_of<vector_dynamic_t>();
   }
 
+  // The dynamic this one stands for: the target of a dynamic_ref, with its
+  // renames applied to an ordered_map_t copy if it has any, otherwise this
+  const dynamic& resolve(dynamic* scratch) const;
+
   // Change the type of this to be the same as other.
   // Only this->is_of<string-ish> is supported.
   //
@@ -309,6 +522,9 @@ public:
     // Currently we only support returning a const dynamic&
     if (this->is_of<vector_dynamic_t>()) {
       return this->getVectorItemRef<vector_dynamic_t>(idx);
+    } else if (this->is_of<dynamic_ref>() &&
+               this->getRef<dynamic_ref>().renames == nullptr) {
+      return this->getRef<dynamic_ref>().target->at(idx);
     } else {
       try {
         dynamic key = (int64_t)(idx);
@@ -341,6 +557,12 @@ public:
     }
   }
 
+  // The value of key in a map, or in the map a view stands for. nullptr
+  // if there is none or this isn't a map. Unlike at(), it neither builds a
+  // key dynamic nor throws. Rows looked up by the same attribute over and
+  // over are better served by an AttributeSlot.
+  const dynamic* find(folly::StringPiece key) const;
+
   // We mimic the behaviour from STL: for non-const reference,
   // square brackets operator for maps automatically inserts
   // default-constructed value if key does not exist.
@@ -372,6 +594,65 @@ public:
   void merge(const dynamic& other);
 
 private:
+ // Overloaded on the types in detail::dynamic_types, the overload picked
+ // for a value decides the type it is held as
+ void construct(boost::blank) { tag_ = 0; }
+ void construct(bool v) { init<bool>(v); }
+ void construct(int64_t v) { init<int64_t>(v); }
+ void construct(double v) { init<double>(v); }
+ void construct(folly::StringPiece v) { init<folly::StringPiece>(v); }
+ void construct(const std::string& v) { init<std::string>(v); }
+ void construct(std::string&& v) { init<std::string>(std::move(v)); }
+ void construct(const vector_dynamic_t& v) { init<vector_dynamic_t>(v); }
+ void construct(vector_dynamic_t&& v) {
+   init<vector_dynamic_t>(std::move(v));
+ }
+ void construct(const std::vector<int64_t>& v) {
+   init<std::vector<int64_t>>(v);
+ }
+ void construct(std::vector<int64_t>&& v) {
+   init<std::vector<int64_t>>(std::move(v));
+ }
+ void construct(const std::vector<folly::StringPiece>& v) {
+   init<std::vector<folly::StringPiece>>(v);
+ }
+ void construct(std::vector<folly::StringPiece>&& v) {
+   init<std::vector<folly::StringPiece>>(std::move(v));
+ }
+ void construct(const unordered_map_t& v) { init<unordered_map_t>(v); }
+ void construct(unordered_map_t&& v) { init<unordered_map_t>(std::move(v)); }
+ void construct(const ordered_map_t& v) { init<ordered_map_t>(v); }
+ void construct(ordered_map_t&& v) { init<ordered_map_t>(std::move(v)); }
+ void construct(const vector_pair_t& v) { init<vector_pair_t>(v); }
+ void construct(vector_pair_t&& v) { init<vector_pair_t>(std::move(v)); }
+ void construct(const dynamic_ref& v) { init<dynamic_ref>(v); }
+
+ template <typename T, typename U>
+ void init(U&& v) {
+   detail::slot<T>::construct(storage_, std::forward<U>(v));
+   tag_ = detail::type_index<T>::value;
+ }
+
+ // The held value, without checking the tag
+ template <typename T>
+ const T& as() const {
+   return detail::slot<T>::get(storage_);
+ }
+ template <typename T>
+ T& as() {
+   return detail::slot<T>::get(storage_);
+ }
+
+ template <typename D, typename F>
+ static decltype(auto) dispatch(D& d, F&& f);
+
+ bool boxed() const {
+   return (detail::boxed_mask<detail::dynamic_types>::value >> tag_) & 1;
+ }
+
+ // Frees a boxed value
+ void destroy();
+
  // Used internally for operator[]. Behaves like at,
  // but when key is not found, it inserts it with
  // default constructed value if possible.
@@ -401,12 +682,113 @@ private:
    T& vec = this->getNonConstRef<T>();
    return static_cast<dynamic&>(vec.at(idx));
  }
+
+ static constexpr size_t kInlineSize = 16;
+
+ alignas(8) unsigned char storage_[kInlineSize];
+ uint8_t tag_ = 0;
 };
-// Ensure the size is cache line efficient.
-// The biggest variable currently is std::string
-// which varies between 8, 24 and 32 bytes depending on implementation.
-// TODO: Investigate std::vector<char> as an alternative.
-static_assert(sizeof(dynamic) <= 40, "too large");
+// Ensure the size is cache line efficient: 16 bytes of inline storage and
+// the tag. std::string and the containers are boxed, see detail::is_boxed.
+static_assert(sizeof(dynamic) <= 24, "too large");
+static_assert(sizeof(folly::StringPiece) <= 16 && sizeof(dynamic_ref) <= 16,
+              "inline types must fit the storage of a dynamic");
+static_assert(std::is_trivially_copyable<folly::StringPiece>::value &&
+                  std::is_trivially_copyable<dynamic_ref>::value,
+              "dynamics are moved by copying their bytes");
+
+template <typename D, typename F>
+inline decltype(auto) dynamic::dispatch(D& d, F&& f) {
+  switch (d.tag_) {
+    case detail::type_index<boost::blank>::value:
+      return f(d.template as<boost::blank>());
+    case detail::type_index<bool>::value:
+      return f(d.template as<bool>());
+    case detail::type_index<int64_t>::value:
+      return f(d.template as<int64_t>());
+    case detail::type_index<double>::value:
+      return f(d.template as<double>());
+    case detail::type_index<folly::StringPiece>::value:
+      return f(d.template as<folly::StringPiece>());
+    case detail::type_index<std::string>::value:
+      return f(d.template as<std::string>());
+    case detail::type_index<vector_dynamic_t>::value:
+      return f(d.template as<vector_dynamic_t>());
+    case detail::type_index<std::vector<int64_t>>::value:
+      return f(d.template as<std::vector<int64_t>>());
+    case detail::type_index<std::vector<folly::StringPiece>>::value:
+      return f(d.template as<std::vector<folly::StringPiece>>());
+    case detail::type_index<unordered_map_t>::value:
+      return f(d.template as<unordered_map_t>());
+    case detail::type_index<ordered_map_t>::value:
+      return f(d.template as<ordered_map_t>());
+    case detail::type_index<vector_pair_t>::value:
+      return f(d.template as<vector_pair_t>());
+    default:
+      return f(d.template as<dynamic_ref>());
+  }
+}
+
+template <typename F>
+inline decltype(auto) dynamic::visit(F&& f) const {
+  return dispatch(*this, std::forward<F>(f));
+}
+
+template <typename F>
+inline decltype(auto) dynamic::visit(F&& f) {
+  return dispatch(*this, std::forward<F>(f));
+}
+
+inline dynamic::dynamic(const dynamic& d) : tag_(d.tag_) {
+  if (!d.boxed()) {
+    std::memcpy(storage_, d.storage_, sizeof(storage_));
+    return;
+  }
+  d.visit([this](const auto& v) {
+    typedef typename std::decay<decltype(v)>::type T;
+    detail::slot<T>::construct(storage_, v);
+  });
+}
+
+inline void dynamic::destroy() {
+  visit([this](auto& v) {
+    typedef typename std::decay<decltype(v)>::type T;
+    detail::slot<T>::destroy(storage_);
+  });
+}
+
+inline const std::type_info& dynamic::type() const {
+  return visit([](const auto& v) -> const std::type_info& {
+    return typeid(v);
+  });
+}
+
+// Base of the visitors passed to apply_visitor()
+template <typename R = void>
+struct static_visitor {
+  typedef R result_type;
+};
+
+// Calls visitor with the value held by v
+template <typename Visitor>
+inline typename std::decay<Visitor>::type::result_type apply_visitor(
+    Visitor&& visitor, const dynamic& v) {
+  typedef typename std::decay<Visitor>::type::result_type R;
+  return v.visit([&visitor](const auto& x) -> R { return visitor(x); });
+}
+
+// Calls visitor with the values held by v1 and v2, switching on the tag
+// of v1 and then on the tag of v2
+template <typename Visitor>
+inline typename std::decay<Visitor>::type::result_type apply_visitor(
+    Visitor&& visitor, const dynamic& v1, const dynamic& v2) {
+  typedef typename std::decay<Visitor>::type::result_type R;
+  return v1.visit([&visitor, &v2](const auto& x) -> R {
+    return v2.visit([&visitor, &x](const auto& y) -> R {
+      return visitor(x, y);
+    });
+  });
+}
 
 // Add other kinds of makeMap's as needed.
 inline dynamic makeOrderedMap(const dynamic& key, dynamic&& value) {
@@ -424,3 +806,4 @@ void PrintTo(const dynamic& dyn, std::ostream* os);
 #include "iterlib/variant/dynamic-inl.h"
 #include "iterlib/variant/dynamic-folly.h"
 #include "iterlib/variant/dynamic-json.h"
+#include "iterlib/variant/dynamic-binary.h"
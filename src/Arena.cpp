@@ -0,0 +1,44 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/Arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace iterlib {
+
+constexpr size_t Arena::kMinBlockSize;
+constexpr size_t Arena::kMaxBlockSize;
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+  // new[] aligns to max_align_t, so align - 1 bytes of slack are enough
+  const size_t needed = size + align - 1;
+  if (needed > nextBlockSize_ / 2) {
+    // Large requests get their own block and leave the current one as is
+    blocks_.emplace_back(new char[needed]);
+    reserved_ += needed;
+    used_ += size;
+    auto pos = reinterpret_cast<uintptr_t>(blocks_.back().get());
+    return reinterpret_cast<void*>((pos + align - 1) & ~(align - 1));
+  }
+  blocks_.emplace_back(new char[nextBlockSize_]);
+  reserved_ += nextBlockSize_;
+  pos_ = blocks_.back().get();
+  end_ = pos_ + nextBlockSize_;
+  nextBlockSize_ = std::min(nextBlockSize_ * 2, kMaxBlockSize);
+  return allocate(size, align);
+}
+
+folly::StringPiece Arena::copy(folly::StringPiece s) {
+  if (s.empty()) {
+    return folly::StringPiece();
+  }
+  auto data = static_cast<char*>(allocate(s.size(), 1));
+  std::memcpy(data, s.data(), s.size());
+  return folly::StringPiece(data, s.size());
+}
+
+}
@@ -0,0 +1,222 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/AttributeSlot.h"
+
+#include <algorithm>
+
+namespace iterlib {
+
+using variant::dynamic_ref;
+using variant::ordered_map_t;
+using variant::unordered_map_t;
+using variant::vector_pair_t;
+
+constexpr size_t AttributeSlot::kMissing;
+
+namespace {
+
+using Kind = AttributeSlot::Kind;
+using Value = AttributeSlot::Value;
+
+struct classify_visitor : variant::static_visitor<void> {
+  explicit classify_visitor(Value* out) : out_(out) {}
+
+  void operator()(const boost::blank&) const { out_->kind = Kind::MISSING; }
+
+  void operator()(const int64_t v) const {
+    out_->kind = Kind::INT;
+    out_->i = v;
+  }
+
+  void operator()(const double v) const {
+    out_->kind = Kind::DOUBLE;
+    out_->d = v;
+  }
+
+  void operator()(const folly::StringPiece v) const {
+    out_->kind = Kind::STRING;
+    out_->s = v;
+  }
+
+  void operator()(const std::string& v) const {
+    out_->kind = Kind::STRING;
+    out_->s = v;
+  }
+
+  void operator()(const dynamic_ref& v) const {
+    if (v.renames == nullptr) {
+      AttributeSlot::classify(*v.target, out_);
+    } else {
+      out_->kind = Kind::OTHER;
+    }
+  }
+
+  template <typename T>
+  void operator()(const T&) const {
+    out_->kind = Kind::OTHER;
+  }
+
+  Value* out_;
+};
+
+}
+
+AttributeSlot::AttributeSlot(const std::string& name)
+    : name_(name), key_(name) {
+  if (name == kIdKey) {
+    source_ = Source::ID;
+  } else if (name == kTimeKey) {
+    source_ = Source::TIME;
+  } else {
+    source_ = Source::ATTRIBUTE;
+  }
+}
+
+AttributeSlot::Kind AttributeSlot::kindOf(const dynamic& v) {
+  Value res;
+  classify(v, &res);
+  return res.kind;
+}
+
+void AttributeSlot::classify(const dynamic& v, Value* out) {
+  out->dyn = &v;
+  variant::apply_visitor(classify_visitor(out), v);
+}
+
+AttributeSlot::Value AttributeSlot::get(const Item& item) {
+  Value res;
+  switch (source_) {
+  case Source::ID:
+    res.kind = Kind::INT;
+    res.i = static_cast<int64_t>(item.id());
+    res.dyn = nullptr;
+    return res;
+  case Source::TIME:
+    res.kind = Kind::INT;
+    res.i = item.ts();
+    res.dyn = nullptr;
+    return res;
+  default:
+    break;
+  }
+  const auto* v = find(item.value());
+  if (v == nullptr) {
+    res.kind = Kind::MISSING;
+    res.dyn = nullptr;
+  } else {
+    classify(*v, &res);
+  }
+  return res;
+}
+
+size_t AttributeSlot::lookupIndex(const std::vector<std::string>* keys) {
+  for (const auto& cached : cachedKeys_) {
+    if (cached.keys == keys) {
+      return cached.index;
+    }
+  }
+  const auto it = std::find(keys->begin(), keys->end(), name_);
+  const size_t index = it == keys->end() ? kMissing : it - keys->begin();
+  cachedKeys_[nextCached_] = {keys, index};
+  nextCached_ = (nextCached_ + 1) % cachedKeys_.size();
+  return index;
+}
+
+const dynamic* AttributeSlot::find(const dynamic& row) {
+  if (row.is_of<dynamic_ref>()) {
+    const auto& ref = row.getRef<dynamic_ref>();
+    if (ref.renames == nullptr) {
+      return find(*ref.target);
+    }
+    // The name this attribute has in the target only changes with the
+    // renames
+    if (ref.renames != cachedRenames_) {
+      const dynamic* source = nullptr;
+      hidden_ = !ref.sourceKey(key_, &source);
+      if (hidden_ || *source == key_) {
+        renamedSlot_.reset();
+      } else {
+        renamedSlot_ = std::make_shared<AttributeSlot>(source->toString());
+      }
+      cachedRenames_ = ref.renames;
+    }
+    if (hidden_) {
+      return nullptr;
+    }
+    return renamedSlot_ ? renamedSlot_->find(*ref.target) : find(*ref.target);
+  } else if (row.is_of<vector_pair_t>()) {
+    const auto& pair = row.getRef<vector_pair_t>();
+    const auto* keys = pair.first;
+    if (keys == nullptr) {
+      return nullptr;
+    }
+    size_t index = lookupIndex(keys);
+    return index < pair.second.size() ? &pair.second[index] : nullptr;
+  } else if (row.is_of<unordered_map_t>()) {
+    const auto& m = row.getRef<unordered_map_t>();
+    const auto it = m.find(name_);
+    return it == m.end() ? nullptr : &it->second;
+  } else if (row.is_of<ordered_map_t>()) {
+    const auto& m = row.getRef<ordered_map_t>();
+    try {
+      const auto it = m.find(key_);
+      return it == m.end() ? nullptr : &it->second;
+    } catch (const std::exception&) {
+      // Keys that don't compare with strings
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+PartialOrder partialCompare(const Item& v1, const Item& v2,
+                            std::vector<AttributeSlot>& columns,
+                            const std::vector<bool>& isColumnDescending) {
+  if (columns.empty()) {
+    return partialCompare(v1, v2, std::vector<std::string>(),
+                          isColumnDescending);
+  }
+  CHECK_EQ(columns.size(), isColumnDescending.size());
+
+  bool comparable = true;
+  for (size_t i = 0; i < columns.size(); i++) {
+    auto& slot = columns[i];
+    const bool isDescending = isColumnDescending[i];
+    bool attrLess = false;
+    bool attrEqual = true;
+    if (slot.isTime()) {
+      attrEqual = (v1.ts() == v2.ts());
+      attrLess = attrEqual ? false : (isDescending ? (v1.ts() < v2.ts())
+                                                   : (v1.ts() > v2.ts()));
+    } else if (slot.isId()) {
+      attrEqual = (v1.id() == v2.id());
+      attrLess = attrEqual ? false : (isDescending ? (v1.id() < v2.id())
+                                                   : (v1.id() > v2.id()));
+    } else {
+      const auto* found1 = slot.find(v1.value());
+      const auto* found2 = slot.find(v2.value());
+      const auto& attr1 = found1 ? *found1 : dynamic::kNullDynamic;
+      const auto& attr2 = found2 ? *found2 : dynamic::kNullDynamic;
+      try {
+        attrEqual = (attr1 == attr2);
+        attrLess = attrEqual ? false : (isDescending ? (attr1 < attr2)
+                                                     : (attr1 > attr2));
+      } catch (const std::exception& ex) {
+        // == does not throw, but < does
+        attrEqual = true;
+        attrLess = false;
+        comparable = false;
+        LOG_EVERY_N(WARNING, 1000) << ex.what();
+      }
+    }
+    if (!attrEqual) {
+      return attrLess ? PartialOrder::LT : PartialOrder::GT;
+    }
+  }
+  return comparable ? PartialOrder::EQ : PartialOrder::NONE;
+}
+
+}
@@ -0,0 +1,19 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+
+#include "iterlib/CountDistinctIterator.h"
+
+namespace iterlib {
+namespace detail {
+
+template <typename T>
+const T CountDistinctIterator<T>::kCountDistinctKey{
+    {folly::StringPiece("count_distinct")}};
+
+template class CountDistinctIterator<Item>;
+
+}
+}
@@ -24,25 +24,24 @@ void dynamic::merge(const dynamic& other) {
   try {
     mergeImpl(other);
   } catch (const std::exception& e) {
-    LOG(ERROR) << "Error merging: " << toJson() << " " << other.toJson() << " "
-               << e.what();
-    throw e;
+    LOG(ERROR) << "Error merging dynamic types " << which() << " and "
+               << other.which() << ": " << e.what();
+    throw;
   }
 }
 
 void dynamic::mergeImpl(const dynamic& other) {
   DCHECK(other.isObject());
   for (const auto& element : other) {
-    const auto first = dynamic(element.first);
-    const auto second = dynamic(element.second.get());
-    VLOG(1) << "Merging: " << first.toJson() << " : " << second.toJson();
+    const dynamic& first = element.first;
+    const dynamic& second = element.second.get();
     if (atNoThrow(first) != kNullDynamic) {
       if (at(first).isObject()) {
         // Example:
         // aggregate(k => { "id" : v1 }, k => { "id" : v2 })
         // will result in
         // k => [ { "id" : v1 }, { "id" : v2 } ]
-        const dynamic_variant& val = (*this)[first];
+        const dynamic& val = (*this)[first];
         auto tmp = vector_dynamic_t({val});
         (*this)[first] = std::move(tmp);
       }
@@ -0,0 +1,439 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/variant/dynamic.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace iterlib {
+namespace variant {
+
+namespace {
+
+// The encoding writes fixed size integers in host order
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__,
+              "The binary encoding of dynamic assumes little endian");
+
+typedef BinaryView::Tag Tag;
+
+void writeVarint(uint64_t v, std::string* out) {
+  while (v >= 0x80) {
+    out->push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out->push_back(static_cast<char>(v));
+}
+
+template <typename T>
+void writeFixed(T v, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+void truncated() {
+  throw std::out_of_range("Truncated binary dynamic");
+}
+
+uint64_t readVarint(const char** pos, const char* end) {
+  uint64_t v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*pos == end) {
+      truncated();
+    }
+    uint8_t byte = *(*pos)++;
+    v |= uint64_t(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return v;
+    }
+  }
+  throw std::logic_error("Malformed varint in binary dynamic");
+}
+
+template <typename T>
+T readFixed(const char* pos, const char* end) {
+  if (end - pos < static_cast<ssize_t>(sizeof(T))) {
+    truncated();
+  }
+  T v;
+  std::memcpy(&v, pos, sizeof(T));
+  return v;
+}
+
+struct BinaryEncoder : static_visitor<> {
+  explicit BinaryEncoder(std::string* out) : out_(out) {}
+
+  void operator()(const boost::blank) const { tag(Tag::kNull); }
+
+  void operator()(const bool v) const { tag(v ? Tag::kTrue : Tag::kFalse); }
+
+  void operator()(const int64_t v) const {
+    tag(Tag::kInt);
+    // zigzag, so small negative numbers are short too
+    writeVarint((uint64_t(v) << 1) ^ uint64_t(v >> 63), out_);
+  }
+
+  void operator()(const double v) const {
+    tag(Tag::kDouble);
+    writeFixed(v, out_);
+  }
+
+  void operator()(const folly::StringPiece v) const {
+    tag(Tag::kString);
+    writeVarint(v.size(), out_);
+    out_->append(v.data(), v.size());
+  }
+
+  void operator()(const std::string& v) const {
+    (*this)(folly::StringPiece(v));
+  }
+
+  void operator()(const vector_dynamic_t& vec) const {
+    container(Tag::kArray, vec.size(), [&](size_t i) {
+      apply_visitor(*this, vec[i]);
+    });
+  }
+
+  void operator()(const std::vector<int64_t>& vec) const {
+    tag(Tag::kIntVector);
+    writeVarint(vec.size(), out_);
+    for (auto v : vec) {
+      writeFixed(v, out_);
+    }
+  }
+
+  void operator()(const std::vector<folly::StringPiece>& vec) const {
+    container(Tag::kStringVector, vec.size(),
+              [&](size_t i) { (*this)(vec[i]); });
+  }
+
+  void operator()(const unordered_map_t& m) const {
+    Entries entries;
+    entries.reserve(m.size());
+    for (const auto& item : m) {
+      entries.emplace_back(item.first, &item.second);
+    }
+    object(&entries);
+  }
+
+  void operator()(const ordered_map_t& m) const {
+    auto it = m.begin();
+    container(Tag::kMap, m.size(), [&](size_t) {
+      apply_visitor(*this, it->first);
+      apply_visitor(*this, it->second);
+      ++it;
+    });
+  }
+
+  void operator()(const vector_pair_t& pair) const {
+    if (pair.first == nullptr) {
+      throw std::logic_error("Malformed dynamic, key vector was null");
+    }
+    Entries entries;
+    entries.reserve(pair.second.size());
+    for (size_t i = 0; i < pair.second.size(); ++i) {
+      entries.emplace_back((*pair.first)[i], &pair.second[i]);
+    }
+    object(&entries);
+  }
+
+  void operator()(const dynamic_ref& ref) const {
+    if (ref.renames == nullptr || !ref.target->isObject()) {
+      apply_visitor(*this, *ref.target);
+      return;
+    }
+    const dynamic view = ref;
+    Entries entries;
+    for (const auto& item : view) {
+      const dynamic& key = item.first;
+      const dynamic& value = item.second;
+      if (key.is_of<std::string>()) {
+        entries.emplace_back(key.getRef<std::string>(), &value);
+      } else if (key.is_of<folly::StringPiece>()) {
+        entries.emplace_back(key.getRef<folly::StringPiece>(), &value);
+      } else {
+        throw std::logic_error("Binary encoding needs string keys in views");
+      }
+    }
+    object(&entries);
+  }
+
+ private:
+  typedef std::vector<std::pair<folly::StringPiece, const dynamic*>> Entries;
+
+  void tag(Tag t) const { out_->push_back(static_cast<char>(t)); }
+
+  void object(Entries* entries) const {
+    std::sort(entries->begin(), entries->end(),
+              [](const Entries::value_type& a, const Entries::value_type& b) {
+                return a.first < b.first;
+              });
+    container(Tag::kObject, entries->size(), [&](size_t i) {
+      (*this)((*entries)[i].first);
+      apply_visitor(*this, *(*entries)[i].second);
+    });
+  }
+
+  // Reserves the payload size and offset table, and fills them in as the
+  // entries are written
+  template <typename F>
+  void container(Tag t, size_t count, F writeEntry) const {
+    tag(t);
+    writeVarint(count, out_);
+    const size_t header = out_->size();
+    out_->append(sizeof(uint32_t) * (count + 1), '\0');
+    const size_t payload = out_->size();
+    for (size_t i = 0; i < count; ++i) {
+      patch(header + sizeof(uint32_t) * (i + 1), out_->size() - payload);
+      writeEntry(i);
+    }
+    patch(header, out_->size() - payload);
+  }
+
+  void patch(size_t pos, size_t value) const {
+    if (value > std::numeric_limits<uint32_t>::max()) {
+      throw std::length_error("Binary dynamic containers are limited to 4GB");
+    }
+    uint32_t v = value;
+    std::memcpy(&(*out_)[pos], &v, sizeof(v));
+  }
+
+  std::string* out_;
+};
+
+}
+
+void toBinary(const dynamic& v, std::string* out) {
+  apply_visitor(BinaryEncoder(out), v);
+}
+
+dynamic fromBinary(folly::StringPiece data, size_t maxDepth) {
+  return BinaryView(data).decode(maxDepth);
+}
+
+BinaryView::BinaryView(folly::StringPiece data) {
+  if (data.empty()) {
+    truncated();
+  }
+  const char* pos = data.begin();
+  const char* end = data.end();
+  tag_ = static_cast<Tag>(*pos++);
+  switch (tag_) {
+    case kNull:
+    case kFalse:
+    case kTrue:
+      break;
+    case kInt:
+      readVarint(&pos, end);
+      break;
+    case kDouble:
+      readFixed<double>(pos, end);
+      pos += sizeof(double);
+      break;
+    case kString: {
+      auto size = readVarint(&pos, end);
+      if (uint64_t(end - pos) < size) {
+        truncated();
+      }
+      pos += size;
+      break;
+    }
+    case kIntVector: {
+      count_ = readVarint(&pos, end);
+      if (uint64_t(end - pos) / sizeof(int64_t) < count_) {
+        truncated();
+      }
+      payload_ = pos;
+      pos += count_ * sizeof(int64_t);
+      break;
+    }
+    case kArray:
+    case kStringVector:
+    case kObject:
+    case kMap: {
+      count_ = readVarint(&pos, end);
+      // Every entry takes at least its offset and a tag, so this bounds a
+      // corrupt count before it is used in any arithmetic
+      if (count_ > uint64_t(end - pos) / (sizeof(uint32_t) + 1)) {
+        truncated();
+      }
+      auto size = readFixed<uint32_t>(pos, end);
+      if (uint64_t(end - pos) / sizeof(uint32_t) < count_ + 1) {
+        truncated();
+      }
+      offsets_ = pos + sizeof(uint32_t);
+      payload_ = offsets_ + sizeof(uint32_t) * count_;
+      if (uint64_t(end - payload_) < size) {
+        truncated();
+      }
+      pos = payload_ + size;
+      break;
+    }
+    default:
+      throw std::logic_error("Unknown tag in binary dynamic");
+  }
+  data_ = folly::StringPiece(data.begin(), pos);
+}
+
+void BinaryView::expect(bool matches) const {
+  if (!matches) {
+    throw std::logic_error(
+        folly::to<std::string>("Unexpected tag ", int(tag_),
+                               " in binary dynamic"));
+  }
+}
+
+void BinaryView::checkIndex(size_t i) const {
+  if (i >= count_) {
+    throw std::out_of_range("Index out of range in binary dynamic");
+  }
+}
+
+bool BinaryView::asBool() const {
+  expect(tag_ == kFalse || tag_ == kTrue);
+  return tag_ == kTrue;
+}
+
+int64_t BinaryView::asInt() const {
+  expect(tag_ == kInt);
+  const char* pos = data_.begin() + 1;
+  uint64_t v = readVarint(&pos, data_.end());
+  return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+double BinaryView::asDouble() const {
+  expect(tag_ == kDouble);
+  return readFixed<double>(data_.begin() + 1, data_.end());
+}
+
+folly::StringPiece BinaryView::asString() const {
+  expect(tag_ == kString);
+  const char* pos = data_.begin() + 1;
+  auto size = readVarint(&pos, data_.end());
+  return folly::StringPiece(pos, size);
+}
+
+size_t BinaryView::size() const {
+  expect(tag_ >= kIntVector);
+  return count_;
+}
+
+folly::StringPiece BinaryView::element(size_t i) const {
+  checkIndex(i);
+  auto begin = readFixed<uint32_t>(offsets_ + sizeof(uint32_t) * i,
+                                   payload_);
+  if (payload_ + begin > data_.end()) {
+    truncated();
+  }
+  return folly::StringPiece(payload_ + begin, data_.end());
+}
+
+BinaryView BinaryView::at(size_t i) const {
+  expect(tag_ == kArray || tag_ == kStringVector);
+  return BinaryView(element(i));
+}
+
+int64_t BinaryView::intAt(size_t i) const {
+  expect(tag_ == kIntVector);
+  checkIndex(i);
+  return readFixed<int64_t>(payload_ + sizeof(int64_t) * i, data_.end());
+}
+
+BinaryView BinaryView::key(size_t i) const {
+  expect(tag_ == kObject || tag_ == kMap);
+  return BinaryView(element(i));
+}
+
+BinaryView BinaryView::value(size_t i) const {
+  auto k = key(i);
+  return BinaryView(folly::StringPiece(k.bytes().end(), data_.end()));
+}
+
+bool BinaryView::find(folly::StringPiece key, BinaryView* value) const {
+  if (tag_ != kObject) {
+    return false;
+  }
+  size_t lo = 0;
+  size_t hi = count_;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    auto k = this->key(mid);
+    auto s = k.asString();
+    if (s == key) {
+      *value = BinaryView(folly::StringPiece(k.bytes().end(), data_.end()));
+      return true;
+    }
+    if (s < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+dynamic BinaryView::decode(size_t maxDepth) const {
+  if ((tag_ == kArray || tag_ == kObject || tag_ == kMap) && maxDepth == 0) {
+    throw std::out_of_range("Binary dynamic nested too deep");
+  }
+  switch (tag_) {
+    case kNull:
+      return dynamic();
+    case kFalse:
+    case kTrue:
+      return asBool();
+    case kInt:
+      return asInt();
+    case kDouble:
+      return asDouble();
+    case kString:
+      return asString();
+    case kIntVector: {
+      std::vector<int64_t> vec(count_);
+      for (size_t i = 0; i < count_; ++i) {
+        vec[i] = intAt(i);
+      }
+      return vec;
+    }
+    case kArray: {
+      vector_dynamic_t vec;
+      vec.reserve(count_);
+      for (size_t i = 0; i < count_; ++i) {
+        vec.push_back(at(i).decode(maxDepth - 1));
+      }
+      return vec;
+    }
+    case kStringVector: {
+      std::vector<folly::StringPiece> vec;
+      vec.reserve(count_);
+      for (size_t i = 0; i < count_; ++i) {
+        vec.push_back(at(i).asString());
+      }
+      return vec;
+    }
+    case kObject: {
+      unordered_map_t m;
+      m.reserve(count_);
+      for (size_t i = 0; i < count_; ++i) {
+        m.emplace(key(i).asString().str(), value(i).decode(maxDepth - 1));
+      }
+      return m;
+    }
+    case kMap: {
+      ordered_map_t m;
+      m.reserve(count_);
+      for (size_t i = 0; i < count_; ++i) {
+        m.insert(std::make_pair(key(i).decode(maxDepth - 1),
+                                value(i).decode(maxDepth - 1)));
+      }
+      return m;
+    }
+  }
+  throw std::logic_error("Unknown tag in binary dynamic");
+}
+
+}
+}
@@ -0,0 +1,426 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/variant/dynamic.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+namespace iterlib {
+namespace variant {
+
+namespace {
+
+const uint64_t kFnvOffset = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+// First '"' or '\\' in [p, end), end if there is none
+inline const char* findQuoteOrEscape(const char* p, const char* end) {
+#ifdef __SSE4_2__
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i escape = _mm_set1_epi8('\\');
+  for (; end - p >= 16; p += 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const uint32_t mask = _mm_movemask_epi8(_mm_or_si128(
+        _mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, escape)));
+    if (mask != 0) {
+      return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; p != end; ++p) {
+    if (*p == '"' || *p == '\\') {
+      return p;
+    }
+  }
+  return end;
+}
+
+void appendUtf8(uint32_t cp, std::string* out) {
+  if (cp < 0x80) {
+    out->push_back(cp);
+  } else if (cp < 0x800) {
+    out->push_back(0xc0 | (cp >> 6));
+    out->push_back(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    out->push_back(0xe0 | (cp >> 12));
+    out->push_back(0x80 | ((cp >> 6) & 0x3f));
+    out->push_back(0x80 | (cp & 0x3f));
+  } else {
+    out->push_back(0xf0 | (cp >> 18));
+    out->push_back(0x80 | ((cp >> 12) & 0x3f));
+    out->push_back(0x80 | ((cp >> 6) & 0x3f));
+    out->push_back(0x80 | (cp & 0x3f));
+  }
+}
+
+class JsonParser {
+ public:
+  JsonParser(folly::StringPiece json, const JsonParseOptions& options)
+      : begin_(json.begin()),
+        pos_(json.begin()),
+        end_(json.end()),
+        options_(options) {}
+
+  dynamic parse() {
+    dynamic v = parseValue(0);
+    skipWhitespace();
+    if (pos_ != end_) {
+      error("unexpected trailing input");
+    }
+    return v;
+  }
+
+ private:
+  [[noreturn]] void error(const char* what) const {
+    throw std::runtime_error(folly::to<std::string>(
+        "JSON parse error at offset ", pos_ - begin_, ": ", what));
+  }
+
+  void skipWhitespace() {
+    while (pos_ != end_ &&
+           (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\t' || *pos_ == '\r')) {
+      ++pos_;
+    }
+  }
+
+  char peek() {
+    skipWhitespace();
+    if (pos_ == end_) {
+      error("unexpected end of input");
+    }
+    return *pos_;
+  }
+
+  void literal(folly::StringPiece word) {
+    if (folly::StringPiece(pos_, end_).startsWith(word)) {
+      pos_ += word.size();
+    } else {
+      error("invalid literal");
+    }
+  }
+
+  dynamic parseValue(size_t depth) {
+    switch (peek()) {
+      case '{':
+        return options_.shapes ? parseShapedObject(depth + 1)
+                               : parseObject(depth + 1);
+      case '[':
+        return parseArray(depth + 1);
+      case '"': {
+        folly::StringPiece raw;
+        std::string decoded;
+        if (!parseString(&raw, &decoded)) {
+          return decoded;
+        }
+        if (options_.borrowStrings) {
+          return raw;
+        }
+        return raw.str();
+      }
+      case 't':
+        literal("true");
+        return true;
+      case 'f':
+        literal("false");
+        return false;
+      case 'n':
+        literal("null");
+        return dynamic();
+      default:
+        return parseNumber();
+    }
+  }
+
+  void enter(size_t depth) {
+    if (depth > options_.maxDepth) {
+      error("nesting too deep");
+    }
+    ++pos_;
+  }
+
+  // Moves past the ',' between elements. Returns false at the closing
+  // bracket, which is skipped too.
+  bool nextElement(char close) {
+    const char c = peek();
+    ++pos_;
+    if (c == close) {
+      return false;
+    }
+    if (c != ',') {
+      error("expected ',' or a closing bracket");
+    }
+    return true;
+  }
+
+  dynamic parseArray(size_t depth) {
+    enter(depth);
+    vector_dynamic_t vec;
+    if (peek() == ']') {
+      ++pos_;
+      return vec;
+    }
+    do {
+      vec.push_back(parseValue(depth));
+    } while (nextElement(']'));
+    return vec;
+  }
+
+  // Parses "key": and leaves pos_ at the value
+  void parseKey(folly::StringPiece* raw, std::string* decoded) {
+    if (peek() != '"') {
+      error("expected a key");
+    }
+    if (!parseString(raw, decoded)) {
+      *raw = *decoded;
+    }
+    if (peek() != ':') {
+      error("expected ':'");
+    }
+    ++pos_;
+  }
+
+  dynamic parseObject(size_t depth) {
+    enter(depth);
+    unordered_map_t m;
+    if (peek() == '}') {
+      ++pos_;
+      return m;
+    }
+    folly::StringPiece key;
+    std::string decoded;
+    do {
+      parseKey(&key, &decoded);
+      m[key.str()] = parseValue(depth);
+    } while (nextElement('}'));
+    return m;
+  }
+
+  dynamic parseShapedObject(size_t depth) {
+    enter(depth);
+    if (keys_.size() <= depth) {
+      keys_.resize(depth + 1);
+    }
+    // Reused by every object at this depth
+    auto& keys = keys_[depth];
+    keys.clear();
+    // Keys with escapes, rare enough to not be reused
+    std::deque<std::string> decodedKeys;
+    std::vector<dynamic> values;
+    if (peek() == '}') {
+      ++pos_;
+    } else {
+      do {
+        folly::StringPiece key;
+        std::string decoded;
+        parseKey(&key, &decoded);
+        if (!decoded.empty()) {
+          decodedKeys.push_back(std::move(decoded));
+          key = decodedKeys.back();
+        }
+        keys.push_back(key);
+        values.push_back(parseValue(depth));
+      } while (nextElement('}'));
+    }
+    return vector_pair_t{options_.shapes->intern(keys), std::move(values)};
+  }
+
+  // Parses the string at pos_. Returns true and sets *raw if it has no
+  // escapes, otherwise decodes it into *decoded.
+  bool parseString(folly::StringPiece* raw, std::string* decoded) {
+    const char* start = ++pos_;
+    const char* p = findQuoteOrEscape(start, end_);
+    if (p == end_) {
+      error("unterminated string");
+    }
+    if (*p == '"') {
+      *raw = folly::StringPiece(start, p);
+      pos_ = p + 1;
+      return true;
+    }
+    decoded->assign(start, p);
+    while (*p == '\\') {
+      pos_ = p + 1;
+      unescape(decoded);
+      p = findQuoteOrEscape(pos_, end_);
+      if (p == end_) {
+        error("unterminated string");
+      }
+      decoded->append(pos_, p);
+    }
+    pos_ = p + 1;
+    return false;
+  }
+
+  // Appends the escape sequence at pos_, after the backslash
+  void unescape(std::string* out) {
+    if (pos_ == end_) {
+      error("unterminated string");
+    }
+    const char c = *pos_++;
+    switch (c) {
+      case '"':
+      case '\\':
+      case '/':
+        out->push_back(c);
+        return;
+      case 'b':
+        out->push_back('\b');
+        return;
+      case 'f':
+        out->push_back('\f');
+        return;
+      case 'n':
+        out->push_back('\n');
+        return;
+      case 'r':
+        out->push_back('\r');
+        return;
+      case 't':
+        out->push_back('\t');
+        return;
+      case 'u': {
+        uint32_t cp = parseHex4();
+        // A surrogate pair encodes one code point above 0xffff
+        if (cp >= 0xd800 && cp < 0xdc00 &&
+            folly::StringPiece(pos_, end_).startsWith("\\u")) {
+          pos_ += 2;
+          uint32_t low = parseHex4();
+          if (low < 0xdc00 || low >= 0xe000) {
+            error("invalid surrogate pair");
+          }
+          cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+        }
+        appendUtf8(cp, out);
+        return;
+      }
+      default:
+        error("invalid escape");
+    }
+  }
+
+  uint32_t parseHex4() {
+    if (end_ - pos_ < 4) {
+      error("truncated \\u escape");
+    }
+    uint32_t cp = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = *pos_++;
+      cp <<= 4;
+      if (c >= '0' && c <= '9') {
+        cp |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        cp |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        cp |= c - 'A' + 10;
+      } else {
+        error("invalid \\u escape");
+      }
+    }
+    return cp;
+  }
+
+  bool digit() const { return pos_ != end_ && *pos_ >= '0' && *pos_ <= '9'; }
+
+  void digits() {
+    if (!digit()) {
+      error("expected a digit");
+    }
+    while (digit()) {
+      ++pos_;
+    }
+  }
+
+  dynamic parseNumber() {
+    const char* start = pos_;
+    const bool negative = *pos_ == '-';
+    if (negative) {
+      ++pos_;
+    }
+    if (!digit()) {
+      error("unexpected character");
+    }
+    uint64_t v = 0;
+    bool isDouble = false;
+    while (digit()) {
+      const uint64_t d = *pos_++ - '0';
+      if (v > (std::numeric_limits<uint64_t>::max() - d) / 10) {
+        isDouble = true;
+      }
+      v = v * 10 + d;
+    }
+    if (pos_ != end_ && *pos_ == '.') {
+      ++pos_;
+      digits();
+      isDouble = true;
+    }
+    if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+      ++pos_;
+      if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+        ++pos_;
+      }
+      digits();
+      isDouble = true;
+    }
+    const uint64_t maxInt = std::numeric_limits<int64_t>::max();
+    if (!isDouble && v <= maxInt + (negative ? 1 : 0)) {
+      return negative ? static_cast<int64_t>(0 - v) : static_cast<int64_t>(v);
+    }
+    return folly::to<double>(folly::StringPiece(start, pos_));
+  }
+
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
+  const JsonParseOptions& options_;
+  // Keys of the objects being parsed, by depth. A deque so that growing it
+  // for a nested object keeps the outer ones in place.
+  std::deque<std::vector<folly::StringPiece>> keys_;
+};
+
+}
+
+const std::vector<std::string>* JsonShapes::intern(
+    const std::vector<folly::StringPiece>& keys) {
+  uint64_t hash = kFnvOffset;
+  for (auto key : keys) {
+    for (char c : key) {
+      hash = (hash ^ uint8_t(c)) * kFnvPrime;
+    }
+    // Separates ["ab"] from ["a", "b"]
+    hash = (hash ^ 0xff) * kFnvPrime;
+  }
+  auto range = index_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto& shape = *it->second;
+    if (std::equal(shape.begin(), shape.end(), keys.begin(), keys.end(),
+                   [](const std::string& a, folly::StringPiece b) {
+                     return a == b;
+                   })) {
+      return it->second;
+    }
+  }
+  shapes_.emplace_back();
+  auto& shape = shapes_.back();
+  shape.reserve(keys.size());
+  for (auto key : keys) {
+    shape.push_back(key.str());
+  }
+  index_.emplace(hash, &shape);
+  return &shape;
+}
+
+dynamic fromJson(folly::StringPiece json, const JsonParseOptions& options) {
+  return JsonParser(json, options).parse();
+}
+
+}
+}
@@ -5,6 +5,7 @@ namespace detail {
 
 template class GroupByIterator<Item>;
 template class GroupBySortedCountIterator<Item>;
+template class GroupByCountDistinctIterator<Item>;
 
 }
 }
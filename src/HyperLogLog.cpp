@@ -0,0 +1,308 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/HyperLogLog.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <folly/Hash.h>
+
+namespace iterlib {
+
+namespace {
+
+const char kSparseFormat = 'S';
+const char kDenseFormat = 'D';
+const size_t kHeaderSize = 2;
+const uint64_t kHashSeed = 0x9e3779b97f4a7c15ULL;
+
+// sigma and tau from Ertl, "New cardinality estimation algorithms for
+// HyperLogLog sketches". Both converge in a handful of iterations.
+double sigma(double x) {
+  if (x == 1.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+  double y = 1.0;
+  double z = x;
+  double zPrev;
+  do {
+    x *= x;
+    zPrev = z;
+    z += x * y;
+    y += y;
+  } while (z != zPrev);
+  return z;
+}
+
+double tau(double x) {
+  if (x == 0.0 || x == 1.0) {
+    return 0.0;
+  }
+  double y = 1.0;
+  double z = 1.0 - x;
+  double zPrev;
+  do {
+    x = std::sqrt(x);
+    zPrev = z;
+    y *= 0.5;
+    z -= (1.0 - x) * (1.0 - x) * y;
+  } while (z != zPrev);
+  return z / 3.0;
+}
+
+}
+
+constexpr uint8_t HyperLogLog::kMinPrecision;
+constexpr uint8_t HyperLogLog::kMaxPrecision;
+constexpr uint8_t HyperLogLog::kDefaultPrecision;
+constexpr uint8_t HyperLogLog::kSparsePrecision;
+
+HyperLogLog::HyperLogLog(uint8_t precision) : precision_(precision) {
+  if (precision < kMinPrecision || precision > kMaxPrecision) {
+    throw std::invalid_argument(
+        folly::stringPrintf("Unsupported HyperLogLog precision: %d",
+                            precision));
+  }
+}
+
+std::pair<uint32_t, uint8_t> HyperLogLog::indexAndRank(uint64_t hash,
+                                                       uint8_t precision) {
+  const uint32_t index = hash >> (64 - precision);
+  const uint64_t w = hash << precision;
+  const uint8_t maxRank = 64 - precision + 1;
+  const uint8_t rank =
+      (w == 0) ? maxRank : static_cast<uint8_t>(__builtin_clzll(w) + 1);
+  return std::make_pair(index, rank);
+}
+
+void HyperLogLog::add(uint64_t hash) {
+  if (!isSparse()) {
+    auto ir = indexAndRank(hash, precision_);
+    updateDense(ir.first, ir.second);
+    return;
+  }
+  auto ir = indexAndRank(hash, kSparsePrecision);
+  updateSparse(sparseEntry(ir.first, ir.second));
+}
+
+// The index at kSparsePrecision carries the bits that follow the dense
+// index, so the dense rank can be recovered exactly.
+void HyperLogLog::updateDense(uint32_t entry) {
+  const uint8_t extraBits = kSparsePrecision - precision_;
+  const uint32_t index = sparseIndex(entry);
+  const uint32_t extra = index & ((1U << extraBits) - 1);
+  uint8_t rank;
+  if (extra != 0) {
+    rank = extraBits - (31 - __builtin_clz(extra));
+  } else {
+    rank = extraBits + sparseRank(entry);
+  }
+  updateDense(index >> extraBits, rank);
+}
+
+void HyperLogLog::updateSparse(uint32_t entry) {
+  const auto index = sparseIndex(entry);
+  auto it = std::lower_bound(sparse_.begin(), sparse_.end(),
+                             sparseEntry(index, 0));
+  if (it != sparse_.end() && sparseIndex(*it) == index) {
+    if (sparseRank(*it) < sparseRank(entry)) {
+      *it = entry;
+    }
+    return;
+  }
+  sparse_.insert(it, entry);
+  if (sparse_.size() > maxSparseEntries()) {
+    toDense();
+  }
+}
+
+void HyperLogLog::toDense() {
+  registers_.assign(numRegisters(), 0);
+  for (const auto entry : sparse_) {
+    updateDense(entry);
+  }
+  sparse_.clear();
+  sparse_.shrink_to_fit();
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  if (other.precision_ != precision_) {
+    throw std::invalid_argument(folly::stringPrintf(
+        "Can't merge HyperLogLog of precision %d into precision %d",
+        other.precision_, precision_));
+  }
+  if (other.isSparse()) {
+    for (const auto entry : other.sparse_) {
+      if (isSparse()) {
+        updateSparse(entry);
+      } else {
+        updateDense(entry);
+      }
+    }
+    return;
+  }
+  if (isSparse()) {
+    toDense();
+  }
+  for (size_t i = 0; i < registers_.size(); i++) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+}
+
+int64_t HyperLogLog::estimate() const {
+  if (isSparse()) {
+    // Linear counting
+    const double m = double(1ULL << kSparsePrecision);
+    return std::llround(m * std::log(m / (m - sparse_.size())));
+  }
+
+  const size_t q = 64 - precision_;
+  const double m = numRegisters();
+
+  // Histogram of register values
+  std::vector<uint32_t> counts(q + 2, 0);
+  for (const auto r : registers_) {
+    counts[r]++;
+  }
+
+  double z = m * tau(1.0 - counts[q + 1] / m);
+  for (size_t k = q; k >= 1; k--) {
+    z += counts[k];
+    z *= 0.5;
+  }
+  z += m * sigma(counts[0] / m);
+  const double alpha = 0.5 / std::log(2.0);
+  return std::llround(alpha * m * m / z);
+}
+
+std::string HyperLogLog::serialize() const {
+  std::string out;
+  if (isSparse()) {
+    out.resize(kHeaderSize + sparse_.size() * sizeof(uint32_t));
+    out[0] = kSparseFormat;
+    if (!sparse_.empty()) {
+      memcpy(&out[kHeaderSize], sparse_.data(),
+             sparse_.size() * sizeof(uint32_t));
+    }
+  } else {
+    out.resize(kHeaderSize + registers_.size());
+    out[0] = kDenseFormat;
+    memcpy(&out[kHeaderSize], registers_.data(), registers_.size());
+  }
+  out[1] = static_cast<char>(precision_);
+  return out;
+}
+
+HyperLogLog HyperLogLog::deserialize(folly::StringPiece data) {
+  if (data.size() < kHeaderSize) {
+    throw std::invalid_argument("HyperLogLog data too short");
+  }
+  HyperLogLog hll(static_cast<uint8_t>(data[1]));
+  const auto payload = data.subpiece(kHeaderSize);
+
+  if (data[0] == kSparseFormat) {
+    if (payload.size() % sizeof(uint32_t) != 0) {
+      throw std::invalid_argument("Malformed sparse HyperLogLog data");
+    }
+    hll.sparse_.resize(payload.size() / sizeof(uint32_t));
+    if (!payload.empty()) {
+      memcpy(hll.sparse_.data(), payload.data(), payload.size());
+    }
+    uint32_t prevIndex = 0;
+    for (size_t i = 0; i < hll.sparse_.size(); i++) {
+      const auto entry = hll.sparse_[i];
+      const auto index = sparseIndex(entry);
+      if (index >= (1U << kSparsePrecision) ||
+          sparseRank(entry) > 64 - kSparsePrecision + 1 ||
+          (i > 0 && index <= prevIndex)) {
+        throw std::invalid_argument("Malformed sparse HyperLogLog data");
+      }
+      prevIndex = index;
+    }
+    if (hll.sparse_.size() > hll.maxSparseEntries()) {
+      hll.toDense();
+    }
+  } else if (data[0] == kDenseFormat) {
+    if (payload.size() != hll.numRegisters()) {
+      throw std::invalid_argument("Malformed dense HyperLogLog data");
+    }
+    hll.registers_.assign(payload.begin(), payload.end());
+    for (const auto r : hll.registers_) {
+      if (r > 64 - hll.precision_ + 1) {
+        throw std::invalid_argument("Malformed dense HyperLogLog data");
+      }
+    }
+  } else {
+    throw std::invalid_argument("Unknown HyperLogLog format");
+  }
+  return hll;
+}
+
+uint64_t HyperLogLog::hash(int64_t value) {
+  return folly::hash::twang_mix64(static_cast<uint64_t>(value));
+}
+
+uint64_t HyperLogLog::hash(folly::StringPiece value) {
+  return folly::hash::SpookyHashV2::Hash64(value.data(), value.size(),
+                                           kHashSeed);
+}
+
+uint64_t HyperLogLog::hash(const dynamic& value) {
+  if (value.is_of<int64_t>()) {
+    return hash(value.get<int64_t>());
+  } else if (value.is_of<folly::StringPiece>()) {
+    return hash(value.get<folly::StringPiece>());
+  } else if (value.is_of<std::string>()) {
+    return hash(folly::StringPiece(value.getRef<std::string>()));
+  } else if (value.is_of<bool>()) {
+    return hash(int64_t(value.get<bool>()));
+  } else if (value.is_of<double>()) {
+    const double d = value.get<double>();
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return folly::hash::twang_mix64(bits);
+  }
+  return hash(folly::StringPiece(value.toJson()));
+}
+
+bool HyperLogLog::hashAttribute(const Item& item, const std::string& attr,
+                                uint64_t* out) {
+  if (attr.empty() || attr == kIdKey) {
+    *out = hash(int64_t(item.id()));
+    return true;
+  } else if (attr == kTimeKey) {
+    *out = hash(item.ts());
+    return true;
+  }
+  const auto& v = item.value().atNoThrow(attr);
+  if (v.is_of<boost::blank>()) {
+    return false;
+  }
+  *out = hash(v);
+  return true;
+}
+
+bool HyperLogLog::hashAttribute(const Item& item, AttributeSlot* attr,
+                                uint64_t* out) {
+  if (attr->isId()) {
+    *out = hash(int64_t(item.id()));
+    return true;
+  } else if (attr->isTime()) {
+    *out = hash(item.ts());
+    return true;
+  }
+  const auto* v = attr->find(item.value());
+  if (v == nullptr || v->is_of<boost::blank>()) {
+    return false;
+  }
+  *out = hash(*v);
+  return true;
+}
+
+}
@@ -2,6 +2,8 @@
 
 #include "iterlib/Item.h"
 
+#include <limits>
+
 namespace iterlib {
 
 namespace {
@@ -0,0 +1,726 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/Predicate.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+#include <folly/Conv.h>
+#include <folly/Hash.h>
+#include <folly/Likely.h>
+#include <folly/Memory.h>
+
+#include "iterlib/StringMatcher.h"
+
+namespace iterlib {
+
+using variant::vector_dynamic_t;
+
+namespace {
+
+using Kind = AttributeSlot::Kind;
+using Value = AttributeSlot::Value;
+
+// Result of compare() when the values have no order, e.g. a missing
+// attribute or mismatched types
+const int kIncomparable = 2;
+
+// Three way comparison of a row value against a constant: -1, 0, 1 or
+// kIncomparable
+int compare(const Value& a, const Value& b) {
+  if (a.kind == Kind::MISSING || b.kind == Kind::MISSING) {
+    return kIncomparable;
+  }
+  if (a.kind == b.kind) {
+    switch (a.kind) {
+    case Kind::INT:
+      return a.i < b.i ? -1 : (a.i > b.i ? 1 : 0);
+    case Kind::DOUBLE:
+      if (a.d < b.d) {
+        return -1;
+      } else if (a.d > b.d) {
+        return 1;
+      }
+      return a.d == b.d ? 0 : kIncomparable;
+    case Kind::STRING: {
+      const int c = a.s.compare(b.s);
+      return c < 0 ? -1 : (c > 0 ? 1 : 0);
+    }
+    default:
+      break;
+    }
+  }
+  // Slow path, same semantics as dynamic's own operators
+  if (a.dyn == nullptr || b.dyn == nullptr) {
+    return kIncomparable;
+  }
+  if (*a.dyn == *b.dyn) {
+    return 0;
+  }
+  try {
+    if (*a.dyn < *b.dyn) {
+      return -1;
+    } else if (*b.dyn < *a.dyn) {
+      return 1;
+    }
+  } catch (const std::exception&) {
+  }
+  return kIncomparable;
+}
+
+bool applyOp(FilterType op, int c) {
+  switch (op) {
+  case FilterType::GE:
+    return c == 0 || c == 1;
+  case FilterType::GT:
+    return c == 1;
+  case FilterType::LE:
+    return c == 0 || c == -1;
+  case FilterType::LT:
+    return c == -1;
+  case FilterType::EQ:
+    return c == 0;
+  case FilterType::NE:
+    return c != 0;
+  default:
+    return false;
+  }
+}
+
+// Narrows [*min, *max] to the values v satisfying (v op c)
+void narrowToOp(FilterType op, int64_t c, int64_t* min, int64_t* max) {
+  const int64_t kMin = std::numeric_limits<int64_t>::min();
+  const int64_t kMax = std::numeric_limits<int64_t>::max();
+  switch (op) {
+  case FilterType::GE:
+    *min = std::max(*min, c);
+    break;
+  case FilterType::GT:
+    if (c == kMax) {
+      *min = kMax;
+      *max = kMin;
+    } else {
+      *min = std::max(*min, c + 1);
+    }
+    break;
+  case FilterType::LE:
+    *max = std::min(*max, c);
+    break;
+  case FilterType::LT:
+    if (c == kMin) {
+      *min = kMax;
+      *max = kMin;
+    } else {
+      *max = std::min(*max, c - 1);
+    }
+    break;
+  case FilterType::EQ:
+    *min = std::max(*min, c);
+    *max = std::min(*max, c);
+    break;
+  default:
+    break;
+  }
+}
+
+// A constant operand along with its typed view. The view points into
+// value, so refresh() whenever value changes or moves.
+struct Constant {
+  explicit Constant(dynamic v) : value(std::move(v)) {}
+
+  void refresh() { AttributeSlot::classify(value, &typed); }
+
+  dynamic value;
+  Value typed;
+};
+
+// Converts string constants to the type of the first row value seen for
+// the attribute, so "10" compares as an int against int attributes.
+// Constants that don't convert are left alone and won't match.
+void learnType(const Value& v, Constant* c) {
+  if ((v.kind != Kind::INT && v.kind != Kind::DOUBLE) ||
+      c->typed.kind != Kind::STRING) {
+    return;
+  }
+  try {
+    dynamic tmp = c->value;
+    tmp.castTo(*v.dyn);
+    c->value = std::move(tmp);
+  } catch (const std::exception&) {
+  }
+  c->refresh();
+}
+
+// Type learning state of a single attribute and its constants
+class Operand {
+ public:
+  Operand(const std::string& field, std::vector<dynamic> values)
+      : slot_(field), learned_(slot_.isIdOrTime()) {
+    constants_.reserve(values.size());
+    for (auto& v : values) {
+      constants_.emplace_back(std::move(v));
+    }
+    for (auto& c : constants_) {
+      c.refresh();
+    }
+  }
+
+  Value get(const Item& item) {
+    auto v = slot_.get(item);
+    if (!learned_ && v.kind != Kind::MISSING && !v.dyn->empty()) {
+      learned_ = true;
+      for (auto& c : constants_) {
+        learnType(v, &c);
+      }
+    }
+    return v;
+  }
+
+  const Value& constant(size_t i) const { return constants_[i].typed; }
+
+  bool learned() const { return learned_; }
+
+  const std::string& name() const { return slot_.name(); }
+
+  size_t numConstants() const { return constants_.size(); }
+
+ private:
+  AttributeSlot slot_;
+  std::vector<Constant> constants_;
+  bool learned_;
+};
+
+// Lexicographic comparison of a tuple of attributes against a tuple of
+// constants. A single field is the common case.
+class ComparePredicate : public Predicate {
+ public:
+  ComparePredicate(const std::vector<std::string>& fields,
+                   const std::vector<dynamic>& values, FilterType op)
+      : op_(op) {
+    // Operands hold views into their constants, they must not be moved
+    operands_.reserve(fields.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+      operands_.emplace_back(fields[i], std::vector<dynamic>{values[i]});
+    }
+  }
+
+  bool match(const Item& item) override {
+    int c = 0;
+    for (auto& operand : operands_) {
+      c = compare(operand.get(item), operand.constant(0));
+      if (c != 0) {
+        break;
+      }
+    }
+    return applyOp(op_, c);
+  }
+
+  // Only the first field of a tuple bounds its attribute, and only
+  // loosely: (a, b) > (1, 2) still admits a == 1
+  void narrowRange(const std::string& attribute, int64_t* min,
+                   int64_t* max) const override {
+    const auto& first = operands_[0];
+    if (first.name() != attribute || first.constant(0).kind != Kind::INT) {
+      return;
+    }
+    auto op = op_;
+    if (operands_.size() > 1) {
+      if (op == FilterType::GT) {
+        op = FilterType::GE;
+      } else if (op == FilterType::LT) {
+        op = FilterType::LE;
+      } else if (op != FilterType::GE && op != FilterType::LE &&
+                 op != FilterType::EQ) {
+        return;
+      }
+    }
+    narrowToOp(op, first.constant(0).i, min, max);
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    for (const auto& operand : operands_) {
+      attributes->push_back(operand.name());
+    }
+    return true;
+  }
+
+ private:
+  std::vector<Operand> operands_;
+  FilterType op_;
+};
+
+class RangePredicate : public Predicate {
+ public:
+  RangePredicate(const std::string& field, const dynamic& lo,
+                 const dynamic& hi)
+      : operand_(field, {lo, hi}) {}
+
+  bool match(const Item& item) override {
+    const auto v = operand_.get(item);
+    return applyOp(FilterType::GE, compare(v, operand_.constant(0))) &&
+           applyOp(FilterType::LE, compare(v, operand_.constant(1)));
+  }
+
+  void narrowRange(const std::string& attribute, int64_t* min,
+                   int64_t* max) const override {
+    if (operand_.name() != attribute ||
+        operand_.constant(0).kind != Kind::INT ||
+        operand_.constant(1).kind != Kind::INT) {
+      return;
+    }
+    narrowToOp(FilterType::GE, operand_.constant(0).i, min, max);
+    narrowToOp(FilterType::LE, operand_.constant(1).i, min, max);
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    attributes->push_back(operand_.name());
+    return true;
+  }
+
+ private:
+  Operand operand_;
+};
+
+struct StringPieceHasher {
+  size_t operator()(folly::StringPiece s) const {
+    return folly::hash::SpookyHashV2::Hash64(s.data(), s.size(), 0);
+  }
+};
+
+// Set membership specialized by value type: integers in a sorted vector,
+// strings in a hash set, doubles sorted, anything else compared one by one.
+// Only values of the same kind can be equal, see compare().
+class ValueSet {
+ public:
+  // The values must outlive the set, strings are not copied
+  template <typename F>
+  void build(size_t n, F&& valueAt) {
+    ints_.clear();
+    doubles_.clear();
+    strings_.clear();
+    others_.clear();
+    for (size_t i = 0; i < n; i++) {
+      const Value& v = valueAt(i);
+      switch (v.kind) {
+      case Kind::INT:
+        ints_.push_back(v.i);
+        break;
+      case Kind::DOUBLE:
+        doubles_.push_back(v.d);
+        break;
+      case Kind::STRING:
+        strings_.insert(v.s);
+        break;
+      case Kind::OTHER:
+        others_.push_back(&v);
+        break;
+      default:
+        break;
+      }
+    }
+    std::sort(ints_.begin(), ints_.end());
+    ints_.erase(std::unique(ints_.begin(), ints_.end()), ints_.end());
+    std::sort(doubles_.begin(), doubles_.end());
+  }
+
+  bool contains(const Value& v) const {
+    switch (v.kind) {
+    case Kind::INT:
+      return containsInt(v.i);
+    case Kind::DOUBLE:
+      return std::binary_search(doubles_.begin(), doubles_.end(), v.d);
+    case Kind::STRING:
+      return strings_.count(v.s) != 0;
+    case Kind::OTHER:
+      for (const auto* other : others_) {
+        if (compare(v, *other) == 0) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      return false;
+    }
+  }
+
+ private:
+  // Binary search narrows the candidates down to a block this small, which
+  // is then scanned linearly (two at a time with SSE)
+  static const size_t kScanBlock = 16;
+
+  bool containsInt(int64_t x) const {
+    const int64_t* base = ints_.data();
+    size_t n = ints_.size();
+    while (n > kScanBlock) {
+      const size_t half = n / 2;
+      base = (base[half] <= x) ? base + half : base;
+      n -= half;
+    }
+    size_t i = 0;
+#ifdef __SSE4_2__
+    const __m128i needle = _mm_set1_epi64x(x);
+    for (; i + 2 <= n; i += 2) {
+      const __m128i block =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi64(block, needle)) != 0) {
+        return true;
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      if (base[i] == x) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<int64_t> ints_;
+  std::vector<double> doubles_;
+  std::unordered_set<folly::StringPiece, StringPieceHasher> strings_;
+  std::vector<const Value*> others_;
+};
+
+class InSetPredicate : public Predicate {
+ public:
+  InSetPredicate(const std::string& field, std::vector<dynamic> values)
+      : operand_(field, std::move(values)) {
+    buildSet();
+  }
+
+  bool match(const Item& item) override {
+    const auto v = operand_.get(item);
+    if (UNLIKELY(operand_.learned() != builtLearned_)) {
+      // Constants changed type
+      buildSet();
+    }
+    return set_.contains(v);
+  }
+
+  void narrowRange(const std::string& attribute, int64_t* min,
+                   int64_t* max) const override {
+    if (operand_.name() != attribute) {
+      return;
+    }
+    int64_t lo = std::numeric_limits<int64_t>::max();
+    int64_t hi = std::numeric_limits<int64_t>::min();
+    for (size_t i = 0; i < operand_.numConstants(); i++) {
+      const auto& c = operand_.constant(i);
+      if (c.kind != Kind::INT) {
+        return;
+      }
+      lo = std::min(lo, c.i);
+      hi = std::max(hi, c.i);
+    }
+    *min = std::max(*min, lo);
+    *max = std::min(*max, hi);
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    attributes->push_back(operand_.name());
+    return true;
+  }
+
+ private:
+  void buildSet() {
+    set_.build(operand_.numConstants(),
+               [this](size_t i) -> const Value& {
+                 return operand_.constant(i);
+               });
+    builtLearned_ = operand_.learned();
+  }
+
+  Operand operand_;
+  ValueSet set_;
+  bool builtLearned_;
+};
+
+class StringPredicate : public Predicate {
+ public:
+  StringPredicate(const std::string& field, const dynamic& needle,
+                  FilterType op)
+      : slot_(field), matcher_(needle.toString(), op) {}
+
+  bool match(const Item& item) override {
+    const auto v = slot_.get(item);
+    return v.kind == Kind::STRING && matcher_.match(v.s);
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    attributes->push_back(slot_.name());
+    return true;
+  }
+
+ private:
+  AttributeSlot slot_;
+  StringMatcher matcher_;
+};
+
+class ExistsPredicate : public Predicate {
+ public:
+  explicit ExistsPredicate(const std::string& field) : slot_(field) {}
+
+  bool match(const Item& item) override {
+    return slot_.get(item).kind != Kind::MISSING;
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    attributes->push_back(slot_.name());
+    return true;
+  }
+
+ private:
+  AttributeSlot slot_;
+};
+
+class AndPredicate : public Predicate {
+ public:
+  explicit AndPredicate(std::vector<std::unique_ptr<Predicate>> children)
+      : children_(std::move(children)) {}
+
+  bool match(const Item& item) override {
+    for (auto& child : children_) {
+      if (!child->match(item)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void narrowRange(const std::string& attribute, int64_t* min,
+                   int64_t* max) const override {
+    for (const auto& child : children_) {
+      child->narrowRange(attribute, min, max);
+    }
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    for (const auto& child : children_) {
+      if (!child->addAttributes(attributes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::unique_ptr<Predicate>> children_;
+};
+
+class OrPredicate : public Predicate {
+ public:
+  explicit OrPredicate(std::vector<std::unique_ptr<Predicate>> children)
+      : children_(std::move(children)) {}
+
+  bool match(const Item& item) override {
+    for (auto& child : children_) {
+      if (child->match(item)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // The union of the children's ranges
+  void narrowRange(const std::string& attribute, int64_t* min,
+                   int64_t* max) const override {
+    int64_t lo = std::numeric_limits<int64_t>::max();
+    int64_t hi = std::numeric_limits<int64_t>::min();
+    for (const auto& child : children_) {
+      int64_t childMin = *min;
+      int64_t childMax = *max;
+      child->narrowRange(attribute, &childMin, &childMax);
+      if (childMin <= childMax) {
+        lo = std::min(lo, childMin);
+        hi = std::max(hi, childMax);
+      }
+    }
+    *min = lo;
+    *max = hi;
+  }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    for (const auto& child : children_) {
+      if (!child->addAttributes(attributes)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::unique_ptr<Predicate>> children_;
+};
+
+class NotPredicate : public Predicate {
+ public:
+  explicit NotPredicate(std::unique_ptr<Predicate> child)
+      : child_(std::move(child)) {}
+
+  bool match(const Item& item) override { return !child_->match(item); }
+
+  bool addAttributes(std::vector<std::string>* attributes) const override {
+    return child_->addAttributes(attributes);
+  }
+
+ private:
+  std::unique_ptr<Predicate> child_;
+};
+
+bool isIdOrTime(const std::string& field) {
+  return field == kIdKey || field == kTimeKey;
+}
+
+// :id and :time are always int64_t, so their constants are converted
+// upfront instead of being learned from the first row
+dynamic convertConstant(const std::string& field, const dynamic& value) {
+  if (!isIdOrTime(field) || value.is_of<int64_t>()) {
+    return value;
+  }
+  return folly::to<int64_t>(value.toString());
+}
+
+// Accepts either one value per field or a single vector holding the tuple
+std::vector<dynamic> tupleValues(const std::vector<std::string>& fields,
+                                 const std::vector<dynamic>& values) {
+  const auto& tuple =
+      (values.size() == 1 && values[0].is_of<vector_dynamic_t>())
+          ? values[0].getRef<vector_dynamic_t>()
+          : values;
+  if (tuple.size() != fields.size()) {
+    throw std::invalid_argument(folly::stringPrintf(
+        "Filter on %zu attributes needs as many values, got %zu",
+        fields.size(), tuple.size()));
+  }
+  std::vector<dynamic> res;
+  for (size_t i = 0; i < fields.size(); i++) {
+    res.push_back(convertConstant(fields[i], tuple[i]));
+  }
+  return res;
+}
+
+}
+
+std::unique_ptr<Predicate> Predicate::compile(
+    const std::vector<std::string>& fields,
+    const std::vector<dynamic>& values,
+    FilterType filterType) {
+  if (fields.empty()) {
+    throw std::invalid_argument("Filter without attributes");
+  }
+  if (values.empty() && filterType != FilterType::EXISTS) {
+    throw std::invalid_argument("Filter without values");
+  }
+  const bool single = fields.size() == 1;
+
+  switch (filterType) {
+  case FilterType::GE:
+  case FilterType::GT:
+  case FilterType::LE:
+  case FilterType::LT:
+  case FilterType::NE:
+    return folly::make_unique<ComparePredicate>(
+        fields, tupleValues(fields, values), filterType);
+
+  case FilterType::EQ:
+  case FilterType::INSET:
+    if (single) {
+      if (values.size() == 1) {
+        return folly::make_unique<ComparePredicate>(
+            fields, tupleValues(fields, values), FilterType::EQ);
+      }
+      std::vector<dynamic> set;
+      for (const auto& v : values) {
+        set.push_back(convertConstant(fields[0], v));
+      }
+      return folly::make_unique<InSetPredicate>(fields[0], std::move(set));
+    } else {
+      // Set of tuples, or a single tuple
+      if (!values[0].is_of<vector_dynamic_t>()) {
+        return folly::make_unique<ComparePredicate>(
+            fields, tupleValues(fields, values), FilterType::EQ);
+      }
+      std::vector<std::unique_ptr<Predicate>> tuples;
+      for (const auto& v : values) {
+        tuples.push_back(folly::make_unique<ComparePredicate>(
+            fields, tupleValues(fields, {v}), FilterType::EQ));
+      }
+      return makeOr(std::move(tuples));
+    }
+
+  case FilterType::RANGE:
+    if (!single || values.size() != 2) {
+      throw std::invalid_argument(
+          "RANGE filter takes one attribute and two values");
+    }
+    return folly::make_unique<RangePredicate>(
+        fields[0], convertConstant(fields[0], values[0]),
+        convertConstant(fields[0], values[1]));
+
+  case FilterType::PREFIX:
+  case FilterType::CONTAINS:
+    if (!single || values.size() != 1) {
+      throw std::invalid_argument(
+          "PREFIX and CONTAINS filters take one attribute and one value");
+    }
+    return folly::make_unique<StringPredicate>(fields[0], values[0],
+                                               filterType);
+
+  case FilterType::EXISTS: {
+    std::vector<std::unique_ptr<Predicate>> children;
+    for (const auto& field : fields) {
+      children.push_back(folly::make_unique<ExistsPredicate>(field));
+    }
+    return single ? std::move(children[0]) : makeAnd(std::move(children));
+  }
+
+  default:
+    throw std::invalid_argument(folly::stringPrintf(
+        "Unsupported filter type: %d", static_cast<int>(filterType)));
+  }
+}
+
+std::unique_ptr<Predicate> Predicate::makeAnd(
+    std::vector<std::unique_ptr<Predicate>> children) {
+  if (children.size() == 1) {
+    return std::move(children[0]);
+  }
+  return folly::make_unique<AndPredicate>(std::move(children));
+}
+
+std::unique_ptr<Predicate> Predicate::makeOr(
+    std::vector<std::unique_ptr<Predicate>> children) {
+  if (children.size() == 1) {
+    return std::move(children[0]);
+  }
+  return folly::make_unique<OrPredicate>(std::move(children));
+}
+
+std::unique_ptr<Predicate> Predicate::makeNot(
+    std::unique_ptr<Predicate> child) {
+  return folly::make_unique<NotPredicate>(std::move(child));
+}
+
+std::unique_ptr<Predicate> Predicate::makeAnd(std::unique_ptr<Predicate> a,
+                                              std::unique_ptr<Predicate> b) {
+  if (!a) {
+    return b;
+  } else if (!b) {
+    return a;
+  }
+  std::vector<std::unique_ptr<Predicate>> children;
+  children.push_back(std::move(a));
+  children.push_back(std::move(b));
+  return makeAnd(std::move(children));
+}
+
+}
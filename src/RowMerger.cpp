@@ -0,0 +1,195 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/RowMerger.h"
+
+#include <stdexcept>
+
+namespace iterlib {
+
+using variant::dynamic_ref;
+using variant::ordered_map_t;
+using variant::unordered_map_t;
+using variant::vector_dynamic_t;
+using variant::vector_pair_t;
+
+namespace {
+
+// Replaces a view by a copy of what it stands for
+void materialize(dynamic* d) {
+  if (!d->is_of<dynamic_ref>()) {
+    return;
+  }
+  dynamic scratch;
+  const dynamic& resolved = d->resolve(&scratch);
+  if (&resolved == &scratch) {
+    *d = std::move(scratch);
+  } else {
+    dynamic copy = resolved;
+    *d = std::move(copy);
+  }
+}
+
+// Turns *d into a vector_dynamic_t holding the old value
+void wrap(dynamic* d) {
+  vector_dynamic_t vec;
+  vec.reserve(2);
+  vec.push_back(std::move(*d));
+  *d = std::move(vec);
+}
+
+void append(dynamic* into, const dynamic& from) {
+  auto& vec = into->getNonConstRef<vector_dynamic_t>();
+  if (from.is_of<vector_dynamic_t>()) {
+    const auto& other = from.getRef<vector_dynamic_t>();
+    vec.insert(vec.end(), other.begin(), other.end());
+  } else {
+    vec.push_back(from);
+  }
+}
+
+bool isNumber(const dynamic& d) {
+  return d.is_of<int64_t>() || d.is_of<double>();
+}
+
+double toDouble(const dynamic& d) {
+  return d.is_of<int64_t>() ? static_cast<double>(d.get<int64_t>())
+                            : d.get<double>();
+}
+
+// Adds two numbers in place, returns false if either isn't one
+bool add(dynamic* into, const dynamic& from) {
+  if (into->is_of<int64_t>() && from.is_of<int64_t>()) {
+    into->getNonConstRef<int64_t>() += from.get<int64_t>();
+    return true;
+  } else if (isNumber(*into) && isNumber(from)) {
+    *into = toDouble(*into) + toDouble(from);
+    return true;
+  }
+  return false;
+}
+
+// Sets *name to the attribute a map key stands for, if it is a string
+bool attributeName(const std::string& key, folly::StringPiece* name) {
+  *name = key;
+  return true;
+}
+
+bool attributeName(const dynamic& key, folly::StringPiece* name) {
+  if (key.is_of<std::string>()) {
+    *name = key.getRef<std::string>();
+    return true;
+  } else if (key.is_of<folly::StringPiece>()) {
+    *name = key.get<folly::StringPiece>();
+    return true;
+  }
+  return false;
+}
+
+}
+
+void RowMerger::merge(dynamic* into, const dynamic& from) const {
+  if (!into->isObject() || !from.isObject()) {
+    combine(into, from, defaultStrategy_);
+    return;
+  }
+  materialize(into);
+  if (into->is_of<vector_pair_t>()) {
+    // The key vector is shared, new keys need a map
+    unordered_map_t m;
+    m.reserve(into->size() + from.size());
+    for (const auto& kv : *into) {
+      m.emplace(kv.first.toString(), kv.second.get());
+    }
+    *into = std::move(m);
+  }
+
+  if (into->is_of<unordered_map_t>()) {
+    auto& m = into->getNonConstRef<unordered_map_t>();
+    m.reserve(m.size() + from.size());
+    if (from.is_of<unordered_map_t>()) {
+      for (const auto& kv : from.getRef<unordered_map_t>()) {
+        mergeEntry(&m, kv.first, kv.second);
+      }
+    } else if (from.is_of<vector_pair_t>()) {
+      const auto& pair = from.getRef<vector_pair_t>();
+      for (size_t i = 0; i < pair.second.size(); i++) {
+        mergeEntry(&m, (*pair.first)[i], pair.second[i]);
+      }
+    } else {
+      for (const auto& kv : from) {
+        mergeEntry(&m, kv.first.toString(), kv.second.get());
+      }
+    }
+  } else {
+    auto& m = into->getNonConstRef<ordered_map_t>();
+    m.reserve(m.size() + from.size());
+    for (const auto& kv : from) {
+      mergeEntry(&m, kv.first, kv.second.get());
+    }
+  }
+}
+
+template <typename Map, typename Key>
+void RowMerger::mergeEntry(Map* into, const Key& key,
+                           const dynamic& value) const {
+  auto it = into->find(key);
+  if (it == into->end()) {
+    into->emplace(key, value);
+    return;
+  }
+  MergeStrategy strategy = defaultStrategy_;
+  folly::StringPiece name;
+  if (!strategies_.empty() && attributeName(key, &name)) {
+    strategy = strategyFor(name);
+  }
+  combine(&it->second, value, strategy);
+}
+
+void RowMerger::combine(dynamic* into, const dynamic& from,
+                        MergeStrategy strategy) {
+  switch (strategy) {
+  case MergeStrategy::LAST_WINS:
+    *into = from;
+    return;
+  case MergeStrategy::FIRST_WINS:
+    return;
+  case MergeStrategy::APPEND:
+    if (!into->is_of<vector_dynamic_t>()) {
+      wrap(into);
+    }
+    append(into, from);
+    return;
+  case MergeStrategy::SUM: {
+    materialize(into);
+    dynamic scratch;
+    if (!add(into, from.resolve(&scratch))) {
+      throw std::invalid_argument(
+          folly::stringPrintf("Can't sum dynamic types %d and %d",
+                              into->which(), from.which()));
+    }
+    return;
+  }
+  case MergeStrategy::DEFAULT:
+    break;
+  }
+
+  // Same result as dynamic::merge()
+  if (into->isObject()) {
+    wrap(into);
+  }
+  if (into->is_of<vector_dynamic_t>()) {
+    append(into, from);
+    return;
+  }
+  materialize(into);
+  dynamic scratch;
+  const dynamic& other = from.resolve(&scratch);
+  if (!add(into, other)) {
+    *into += other;
+  }
+}
+
+}
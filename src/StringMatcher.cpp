@@ -0,0 +1,145 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under the BSD-style license found in the
+//  LICENSE file in the root directory of this source tree. An additional grant
+//  of patent rights can be found in the PATENTS file in the same directory.
+
+#include "iterlib/StringMatcher.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+namespace iterlib {
+
+using variant::vector_dynamic_t;
+
+namespace {
+
+#ifdef __SSE4_2__
+const size_t kBlock = 16;
+
+// Loads up to 16 bytes of p without reading past p + n
+inline __m128i loadPartial(const char* p, size_t n) {
+  if (n >= kBlock) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  }
+  alignas(16) char buf[kBlock] = {0};
+  memcpy(buf, p, n);
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+}
+#endif
+
+}
+
+StringMatcher::StringMatcher(std::string needle, FilterType type)
+    : needle_(std::move(needle)), type_(type) {
+  if (type != FilterType::PREFIX && type != FilterType::CONTAINS) {
+    throw std::invalid_argument("StringMatcher supports PREFIX and CONTAINS");
+  }
+  memset(head_, 0, sizeof(head_));
+  memcpy(head_, needle_.data(), std::min(needle_.size(), sizeof(head_)));
+}
+
+bool StringMatcher::startsWith(folly::StringPiece s) const {
+  const size_t n = needle_.size();
+  if (s.size() < n) {
+    return false;
+  }
+#ifdef __SSE4_2__
+  if (n <= kBlock && s.size() >= kBlock) {
+    const __m128i eq = _mm_cmpeq_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(s.data())),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(head_)));
+    const uint32_t mask = (1U << n) - 1;
+    return (static_cast<uint32_t>(_mm_movemask_epi8(eq)) & mask) == mask;
+  }
+#endif
+  return memcmp(s.data(), needle_.data(), n) == 0;
+}
+
+size_t StringMatcher::find(folly::StringPiece s) const {
+  const size_t n = needle_.size();
+  if (n == 0) {
+    return 0;
+  }
+  if (s.size() < n) {
+    return std::string::npos;
+  }
+#ifdef __SSE4_2__
+  // Finds where the first 16 bytes of the needle (or a prefix of them
+  // running off the end of the block) occur, then verifies the candidate
+  const int headLen = std::min(n, kBlock);
+  const __m128i head = _mm_load_si128(reinterpret_cast<const __m128i*>(head_));
+  const char* data = s.data();
+  const size_t size = s.size();
+  size_t i = 0;
+  while (i + n <= size) {
+    const size_t remaining = size - i;
+    const int blockLen = std::min(remaining, kBlock);
+    const __m128i block = loadPartial(data + i, remaining);
+    const int idx = _mm_cmpestri(head, headLen, block, blockLen,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ORDERED);
+    if (idx == int(kBlock)) {
+      i += kBlock;
+      continue;
+    }
+    const size_t pos = i + idx;
+    if (pos + n > size) {
+      return std::string::npos;
+    }
+    if (memcmp(data + pos, needle_.data(), n) == 0) {
+      return pos;
+    }
+    i = pos + 1;
+  }
+  return std::string::npos;
+#else
+  return s.find(needle_);
+#endif
+}
+
+size_t StringMatcher::matchColumn(
+    const std::vector<folly::StringPiece>& column,
+    std::vector<uint32_t>* out) const {
+  size_t matched = 0;
+  for (size_t i = 0; i < column.size(); i++) {
+    if (match(column[i])) {
+      out->push_back(i);
+      matched++;
+    }
+  }
+  return matched;
+}
+
+size_t StringMatcher::matchColumn(const dynamic& column,
+                                  std::vector<uint32_t>* out) const {
+  if (column.is_of<std::vector<folly::StringPiece>>()) {
+    return matchColumn(column.getRef<std::vector<folly::StringPiece>>(), out);
+  } else if (!column.is_of<vector_dynamic_t>()) {
+    return 0;
+  }
+  size_t matched = 0;
+  const auto& values = column.getRef<vector_dynamic_t>();
+  for (size_t i = 0; i < values.size(); i++) {
+    const auto& v = values[i];
+    bool m;
+    if (v.is_of<std::string>()) {
+      m = match(v.getRef<std::string>());
+    } else if (v.is_of<folly::StringPiece>()) {
+      m = match(v.get<folly::StringPiece>());
+    } else {
+      continue;
+    }
+    if (m) {
+      out->push_back(i);
+      matched++;
+    }
+  }
+  return matched;
+}
+
+}
@@ -0,0 +1,56 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+#include <gtest/gtest.h>
+
+#include <list>
+#include <string>
+
+#include "iterlib/Arena.h"
+
+using namespace iterlib;
+
+TEST(Arena, Allocate) {
+  Arena arena;
+  EXPECT_EQ(0, arena.bytesReserved());
+
+  auto* c = static_cast<char*>(arena.allocate(1, 1));
+  auto* d = static_cast<double*>(arena.allocate(sizeof(double),
+                                                alignof(double)));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(d) % alignof(double));
+  EXPECT_LT(static_cast<void*>(c), static_cast<void*>(d));
+  EXPECT_EQ(Arena::kMinBlockSize, arena.bytesReserved());
+
+  // Too large for the next block
+  auto* large = arena.allocate(Arena::kMinBlockSize * 4, 64);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % 64);
+  EXPECT_EQ(1 + sizeof(double) + Arena::kMinBlockSize * 4, arena.bytesUsed());
+
+  // The current block is still used after a large request
+  auto* next = static_cast<char*>(arena.allocate(1, 1));
+  EXPECT_EQ(reinterpret_cast<char*>(d + 1), next);
+}
+
+TEST(Arena, Copy) {
+  Arena arena;
+  std::string s = "some row";
+  auto copy = arena.copy(s);
+  s[0] = 'S';
+  EXPECT_EQ("some row", copy.str());
+  EXPECT_TRUE(arena.copy("").empty());
+}
+
+TEST(Arena, Allocator) {
+  Arena arena;
+  std::list<std::string, ArenaAllocator<std::string>> rows{
+      ArenaAllocator<std::string>(&arena)};
+  for (int i = 0; i < 1000; i++) {
+    rows.emplace_back(std::to_string(i));
+  }
+  EXPECT_EQ("999", rows.back());
+  EXPECT_GE(arena.bytesUsed(), 1000 * sizeof(std::string));
+  EXPECT_LT(arena.bytesReserved(), 4 * arena.bytesUsed());
+}
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
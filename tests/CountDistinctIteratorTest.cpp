@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include "ExpectIterator.h"
+
+#include "iterlib/CountDistinctIterator.h"
+#include "iterlib/FutureIterator.h"
+#include "iterlib/GroupByIterator.h"
+#include "iterlib/HyperLogLog.h"
+
+using namespace iterlib::variant;
+using namespace iterlib;
+
+namespace {
+
+// Rows with ids 0..n-1 and attribute "user" cycling through numUsers values
+std::vector<ItemOptimized> makeRows(int64_t n, int64_t numUsers) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < n; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"user", i % numUsers},
+                                         {"group", i % 2}});
+  }
+  return res;
+}
+
+void expectWithinError(int64_t expected, int64_t actual, double error) {
+  EXPECT_LE(std::abs(actual - expected), expected * error)
+      << "expected " << expected << " got " << actual;
+}
+
+}
+
+TEST(HyperLogLog, Empty) {
+  HyperLogLog hll;
+  EXPECT_EQ(0, hll.estimate());
+  EXPECT_TRUE(hll.isSparse());
+}
+
+TEST(HyperLogLog, SmallCardinalityIsExact) {
+  HyperLogLog hll;
+  for (int64_t i = 0; i < 100; i++) {
+    hll.add(HyperLogLog::hash(i));
+    hll.add(HyperLogLog::hash(i));
+  }
+  EXPECT_TRUE(hll.isSparse());
+  EXPECT_EQ(100, hll.estimate());
+}
+
+TEST(HyperLogLog, LargeCardinality) {
+  HyperLogLog hll;
+  for (int64_t i = 0; i < 200000; i++) {
+    hll.add(HyperLogLog::hash(i));
+  }
+  EXPECT_FALSE(hll.isSparse());
+  expectWithinError(200000, hll.estimate(), 0.03);
+}
+
+TEST(HyperLogLog, StringTypesHashTheSame) {
+  std::string s{"foo"};
+  EXPECT_EQ(HyperLogLog::hash(dynamic(s)),
+            HyperLogLog::hash(dynamic(folly::StringPiece(s))));
+}
+
+TEST(HyperLogLog, MergeAndSerialize) {
+  HyperLogLog a;
+  HyperLogLog b;
+  HyperLogLog all;
+  for (int64_t i = 0; i < 50000; i++) {
+    (i % 2 ? a : b).add(HyperLogLog::hash(i));
+    all.add(HyperLogLog::hash(i));
+  }
+  // b stays sparse
+  HyperLogLog c;
+  for (int64_t i = 0; i < 10; i++) {
+    c.add(HyperLogLog::hash(i + 1000000));
+    all.add(HyperLogLog::hash(i + 1000000));
+  }
+
+  auto merged = HyperLogLog::deserialize(a.serialize());
+  merged.merge(HyperLogLog::deserialize(b.serialize()));
+  merged.merge(HyperLogLog::deserialize(c.serialize()));
+  EXPECT_EQ(all.estimate(), merged.estimate());
+  EXPECT_EQ(all.serialize(), merged.serialize());
+
+  EXPECT_THROW(merged.merge(HyperLogLog(10)), std::invalid_argument);
+  EXPECT_THROW(HyperLogLog::deserialize("X"), std::invalid_argument);
+}
+
+TEST(CountDistinctIterator, Attribute) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(makeRows(1000, 37)));
+  CountDistinctIterator countIt(it.release(), "user");
+  ExpectIterator(&countIt, std::vector<Item>{{Item{{int64_t(37)}}}});
+}
+
+TEST(CountDistinctIterator, Id) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(makeRows(1000, 37)));
+  CountDistinctIterator countIt(it.release());
+  ExpectIterator(&countIt, std::vector<Item>{{Item{{int64_t(1000)}}}});
+}
+
+TEST(CountDistinctIterator, EmptyInput) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(std::vector<ItemOptimized>{}));
+  CountDistinctIterator countIt(it.release(), "user");
+  ExpectIterator(&countIt, std::vector<Item>{{Item{{int64_t(0)}}}});
+}
+
+TEST(CountDistinctIterator, MergeShards) {
+  std::vector<ItemOptimized> sketches;
+  for (int shard = 0; shard < 3; shard++) {
+    // Shards overlap on half of their users
+    std::vector<ItemOptimized> rows;
+    for (int64_t i = 0; i < 20000; i++) {
+      rows.emplace_back(i, 0, ordered_map_t{{"user", shard * 10000 + i}});
+    }
+    auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+        folly::makeFuture(rows));
+    CountDistinctIterator shardIt(it.release(), "user");
+    shardIt.setEmitSketch(true);
+    shardIt.prepare();
+    ASSERT_TRUE(shardIt.next());
+    sketches.emplace_back(shard, 0,
+                          static_cast<const dynamic&>(shardIt.value()));
+    EXPECT_FALSE(shardIt.next());
+  }
+
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(sketches));
+  CountDistinctIterator mergeIt(it.release());
+  mergeIt.setMergeSketches(true);
+  mergeIt.prepare();
+  ASSERT_TRUE(mergeIt.next());
+  expectWithinError(40000, mergeIt.value().get<int64_t>(), 0.03);
+  EXPECT_FALSE(mergeIt.next());
+}
+
+TEST(GroupByCountDistinctIterator, GroupByOneAttr) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(makeRows(1000, 10)));
+  auto groupByIt = folly::make_unique<GroupByCountDistinctIterator>(
+      it.release(), AttributeNameVec{{"group"}}, "user");
+  groupByIt->prepare();
+
+  // Even users land in group 0, odd ones in group 1
+  const auto expected = std::vector<std::pair<int64_t, int64_t>>{{0, 5},
+                                                                  {1, 5}};
+  size_t i = 0;
+  while (groupByIt->next()) {
+    ASSERT_LT(i, expected.size());
+    EXPECT_EQ(dynamic(vector_dynamic_t{{expected[i].first}}),
+              groupByIt->key().value());
+    EXPECT_EQ(expected[i].second, groupByIt->value().get<int64_t>());
+    i++;
+  }
+  EXPECT_EQ(expected.size(), i);
+}
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
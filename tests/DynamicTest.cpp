@@ -2,6 +2,10 @@
 //  This source code is licensed under the BSD-style license found in the
 //  LICENSE file in the root directory of this source tree. An additional grant
 //  of patent rights can be found in the PATENTS file in the same directory.
+#include <algorithm>
+#include <climits>
+#include <limits>
+
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
@@ -52,8 +56,7 @@ TEST(Dynamic, ContainerInit) {
   EXPECT_TRUE(d3.is_of<vector_dynamic_t>());
   auto& v3 = d3.getRef<vector_dynamic_t>();
   EXPECT_EQ(3, v3.size());
-  // Safe only if sizeof(dynamic) == sizeof(dynamic_variant)
-  // and there are no other layout changes
+  // Safe only if there are no layout changes
   auto v4 = reinterpret_cast<std::vector<dynamic> const *>(&v3);
   EXPECT_TRUE((*v4)[0].is_of<int64_t>());
   //EXPECT_TRUE((*v4)[1].is_of<std::string>());
@@ -627,6 +630,22 @@ TEST(Dynamic, MoveTest) {
   EXPECT_EQ(str2.get<std::string>(), "hello world");
 }
 
+TEST(Dynamic, BoxedValues) {
+  dynamic map = unordered_map_t{{"foo", std::string("bar")}};
+  dynamic copy = map;
+  copy["foo"] = 1L;
+  EXPECT_EQ(map["foo"], dynamic("bar"));
+  // Boxed values are taken by a move
+  dynamic moved = std::move(map);
+  EXPECT_TRUE(map.is_of<boost::blank>());
+  EXPECT_TRUE(moved.is_of<unordered_map_t>());
+  // Assigning a part of a value to it
+  moved = moved["foo"];
+  EXPECT_EQ(moved, dynamic("bar"));
+  copy = std::move(copy["foo"]);
+  EXPECT_EQ(copy, 1L);
+}
+
 TEST(Dynamic, Warts) {
   dynamic d3 = 0L;
   dynamic d2 = 0;
@@ -757,6 +776,46 @@ TEST(DynamicAt, VectorPair) {
   EXPECT_THROW(d["four"], std::out_of_range);
 }
 
+TEST(DynamicAt, Ref) {
+  const dynamic target = unordered_map_t{{"a", 1L}, {"b", 2L}, {"c", 3L}};
+  const dynamic plain = dynamic_ref{&target, nullptr};
+  EXPECT_EQ(12, plain.which());
+  EXPECT_TRUE(plain.isObject());
+  EXPECT_EQ(&target.at("a"), &plain.at("a"));
+  EXPECT_EQ(target, plain);
+  EXPECT_EQ(plain, target);
+  EXPECT_EQ(target.toJson(), plain.toJson());
+  EXPECT_EQ(3, plain.size());
+
+  // a => x, b => c hides the original c
+  const rename_vec_t renames{{"a", "x"}, {"b", "c"}};
+  const dynamic view = dynamic_ref{&target, &renames};
+  EXPECT_EQ(&target.at("a"), &view.at("x"));
+  EXPECT_EQ(dynamic(2L), view.at("c"));
+  EXPECT_THROW(view.at("a"), std::out_of_range);
+  EXPECT_THROW(view.at("b"), std::out_of_range);
+  EXPECT_EQ(dynamic::kNullDynamic, view.atNoThrow("a"));
+  EXPECT_EQ(2, view.size());
+  EXPECT_FALSE(view.empty());
+
+  std::map<std::string, int64_t> seen;
+  for (const auto& kv : view) {
+    seen[kv.first.toString()] = kv.second.get().get<int64_t>();
+  }
+  EXPECT_EQ((std::map<std::string, int64_t>{{"x", 1}, {"c", 2}}), seen);
+
+  const dynamic expected = ordered_map_t{{"x", 1L}, {"c", 2L}};
+  EXPECT_EQ(expected, view);
+  EXPECT_NE(target, view);
+  EXPECT_EQ(folly::parseJson(expected.toJson()),
+            folly::parseJson(view.toJson()));
+
+  // Views are read-only
+  dynamic copy = view;
+  EXPECT_THROW(copy.at("x"), std::logic_error);
+  EXPECT_THROW(copy["x"], std::logic_error);
+}
+
 TEST(DynamicAt, SquareBracketsOp) {
   dynamic d = ordered_map_t{{std::string{"foo"}, std::string{"xyz"}}};
   dynamic key = std::string("nonexistent");
@@ -1084,6 +1143,180 @@ TEST(DynamicDotProduct, vector) {
   EXPECT_EQ(0.0, d4 * d4);
 }
 
+TEST(Dynamic, memoryUsage) {
+  const dynamic i = 1L;
+  EXPECT_EQ(sizeof(dynamic), i.memoryUsage());
+  const std::string big(100, 'x');
+  const dynamic s = big;
+  EXPECT_GE(s.memoryUsage(), sizeof(dynamic) + big.size());
+  // StringPieces don't own their bytes
+  const dynamic piece = folly::StringPiece(big);
+  EXPECT_EQ(sizeof(dynamic), piece.memoryUsage());
+  const dynamic vec = vector_dynamic_t{s, i};
+  EXPECT_GE(vec.memoryUsage(),
+            sizeof(dynamic) + s.memoryUsage() + i.memoryUsage());
+  const dynamic map = unordered_map_t{{"s", s}};
+  EXPECT_GT(map.memoryUsage(), sizeof(dynamic) + s.memoryUsage());
+}
+
+TEST(Dynamic, CompareScalars) {
+  EXPECT_TRUE(dynamic(1L) < dynamic(2L));
+  EXPECT_TRUE(dynamic(1.5) == dynamic(1.5));
+  EXPECT_TRUE(dynamic(std::string("a")) < dynamic(std::string("b")));
+  // Mixed string types still compare by content
+  EXPECT_TRUE(dynamic(std::string("a")) == dynamic(folly::StringPiece("a")));
+  EXPECT_TRUE(dynamic(folly::StringPiece("a")) < dynamic(std::string("b")));
+  EXPECT_FALSE(dynamic(1L) == dynamic(1.0));
+  EXPECT_THROW(dynamic(1L) < dynamic(1.0), std::logic_error);
+}
+
+TEST(Dynamic, Binary) {
+  const std::vector<std::string> keys{"b", "a"};
+  const dynamic pair = vector_pair_t{&keys, {dynamic(-3L), dynamic(2.5)}};
+  const dynamic v = vector_dynamic_t{
+      dynamic(), true, 300L, std::string("str"), std::vector<int64_t>{1, -1},
+      std::vector<folly::StringPiece>{"x", "y"},
+      unordered_map_t{{"k", vector_dynamic_t{1L}}},
+      ordered_map_t{{1L, std::string("one")}, {2L, std::string("two")}},
+      pair};
+  const auto bytes = v.toBinary();
+  // Objects are read back as unordered_map_t
+  auto expected = v;
+  expected.getNonConstRef<vector_dynamic_t>().back() =
+      unordered_map_t{{"a", 2.5}, {"b", -3L}};
+  EXPECT_EQ(expected, fromBinary(bytes));
+  // Trailing bytes are not part of the value
+  EXPECT_EQ(bytes.size(), BinaryView(bytes + "xyz").bytes().size());
+  EXPECT_THROW(fromBinary(folly::StringPiece(bytes).subpiece(0, 20)),
+               std::out_of_range);
+
+  // Nested values are read in place
+  const BinaryView view(bytes);
+  EXPECT_EQ(9, view.size());
+  EXPECT_EQ(300, view.at(2).asInt());
+  EXPECT_EQ(-1, view.at(4).intAt(1));
+  const auto str = view.at(3).asString();
+  EXPECT_EQ("str", str.str());
+  EXPECT_GE(str.begin(), bytes.data());
+  EXPECT_LT(str.end(), bytes.data() + bytes.size());
+
+  // vector_pair_t keys are sorted when written
+  const auto object = view.at(8);
+  EXPECT_TRUE(object.isObject());
+  EXPECT_EQ("a", object.key(0).asString().str());
+  BinaryView found;
+  ASSERT_TRUE(object.find("b", &found));
+  EXPECT_EQ(-3, found.asInt());
+  EXPECT_FALSE(object.find("c", &found));
+  EXPECT_THROW(object.at(0), std::logic_error);
+}
+
+TEST(Dynamic, BinaryCorrupt) {
+  // An array whose count is 2^64 - 1, followed by a few bytes
+  std::string bytes(1, char(BinaryView::kArray));
+  bytes.append(9, '\xff');
+  bytes.push_back('\x01');
+  bytes.append(16, '\0');
+  EXPECT_THROW(BinaryView{bytes}, std::out_of_range);
+  // A count just too large for the bytes that follow
+  for (auto tag : {BinaryView::kObject, BinaryView::kIntVector}) {
+    std::string small(1, char(tag));
+    small.push_back('\x04');
+    small.append(16, '\0');
+    EXPECT_THROW(BinaryView{small}, std::out_of_range);
+  }
+  // An offset past the payload
+  auto valid = dynamic(vector_dynamic_t{1L, 2L}).toBinary();
+  valid[6] = '\x7f';
+  EXPECT_THROW(BinaryView(valid).at(0), std::out_of_range);
+  EXPECT_THROW(fromBinary(std::string(1, '\x42')), std::logic_error);
+
+  // Deep nesting is rejected before it can exhaust the stack
+  dynamic deep = vector_dynamic_t{};
+  for (int i = 0; i < 200; i++) {
+    deep = vector_dynamic_t{std::move(deep)};
+  }
+  const auto deepBytes = deep.toBinary();
+  EXPECT_THROW(fromBinary(deepBytes), std::out_of_range);
+  EXPECT_EQ(deep, fromBinary(deepBytes, 201));
+  EXPECT_THROW(fromBinary(deepBytes, 200), std::out_of_range);
+}
+
+TEST(Dynamic, FromJson) {
+  const std::string json =
+      R"({"a": [1, -2, 1.5e3, true, null],)"
+      R"( "s": "plain", "e": "tab\t\u00e9\ud83d\ude00"})";
+  const auto v = fromJson(json);
+  EXPECT_EQ(3, v.size());
+  EXPECT_EQ(dynamic(vector_dynamic_t{1L, -2L, 1500.0, true, dynamic()}),
+            v.at("a"));
+  EXPECT_TRUE(v.at("s").is_of<std::string>());
+  EXPECT_EQ("tab\t\u00e9\U0001F600", v.at("e").getRef<std::string>());
+  // Too large for an int64_t
+  EXPECT_TRUE(fromJson("9223372036854775808").is_of<double>());
+  EXPECT_EQ(std::numeric_limits<int64_t>::min(),
+            fromJson("-9223372036854775808").get<int64_t>());
+
+  // Unescaped strings can point into the input
+  JsonParseOptions borrow;
+  borrow.borrowStrings = true;
+  const auto borrowed = fromJson(json, borrow);
+  const auto s = borrowed.at("s").get<folly::StringPiece>();
+  EXPECT_GT(s.begin(), json.data());
+  EXPECT_LT(s.end(), json.data() + json.size());
+  EXPECT_TRUE(borrowed.at("e").is_of<std::string>());
+
+  for (auto bad : {"", "[1,]", "{\"a\" 1}", "\"open", "[1] 2", "tru"}) {
+    EXPECT_THROW(fromJson(bad), std::runtime_error) << bad;
+  }
+  JsonParseOptions shallow;
+  shallow.maxDepth = 2;
+  EXPECT_NO_THROW(fromJson("[[1]]", shallow));
+  EXPECT_THROW(fromJson("[[[1]]]", shallow), std::runtime_error);
+}
+
+TEST(Dynamic, FromJsonShapes) {
+  JsonShapes shapes;
+  JsonParseOptions options;
+  options.shapes = &shapes;
+  const auto v = fromJson(
+      R"([{"id": 1, "n": "a"}, {"id": 2, "n": "b"}, {"n": "c", "id": 3},)"
+      R"( {"x": {"id": 4, "n": "d"}}])",
+      options);
+  EXPECT_EQ(3, shapes.size());
+  const auto& rows = v.getRef<vector_dynamic_t>();
+  const auto& first = rows[0].getRef<vector_pair_t>();
+  EXPECT_EQ(first.first, rows[1].getRef<vector_pair_t>().first);
+  EXPECT_NE(first.first, rows[2].getRef<vector_pair_t>().first);
+  EXPECT_EQ(first.first,
+            rows[3].at("x").getRef<vector_pair_t>().first);
+  EXPECT_EQ(3, rows[2].at("id").get<int64_t>());
+  EXPECT_EQ("d", rows[3].at("x").at("n").toString());
+}
+
+TEST(DynamicAt, Find) {
+  const std::vector<std::string> keys{"b", "a"};
+  const dynamic maps[] = {
+      unordered_map_t{{"a", 1L}, {"b", 2L}},
+      makeOrderedMap("a", 1L),
+      vector_pair_t{&keys, {2L, 1L}},
+  };
+  for (const auto& m : maps) {
+    ASSERT_NE(nullptr, m.find("a"));
+    EXPECT_EQ(1L, *m.find("a"));
+    EXPECT_EQ(nullptr, m.find("missing"));
+  }
+  EXPECT_EQ(nullptr, dynamic(1L).find("a"));
+
+  // Views look the name up under the key it has in their target
+  const rename_vec_t renames{{dynamic("a"), dynamic("c")}};
+  const dynamic view = dynamic_ref{&maps[0], &renames};
+  EXPECT_EQ(nullptr, view.find("a"));
+  ASSERT_NE(nullptr, view.find("c"));
+  EXPECT_EQ(1L, *view.find("c"));
+  EXPECT_EQ(2L, *view.find("b"));
+}
+
 void DynamicToString(int iters, size_t size) {
   vector_dynamic_t v;
   std::vector<std::string> keyVec =
@@ -1130,6 +1363,135 @@ BENCHMARK_PARAM(FollyDynamicToString, 1000);
 BENCHMARK_PARAM(FollyDynamicToString, 10000);
 BENCHMARK_PARAM(FollyDynamicToString, 100000);
 
+void DynamicIsOf(int iters, size_t size) {
+  vector_dynamic_t v;
+  BENCHMARK_SUSPEND {
+    FOR_EACH_RANGE (i, 0, size) {
+      if (i % 2) {
+        v.emplace_back(int64_t(i));
+      } else {
+        v.emplace_back(folly::to<std::string>(i));
+      }
+    }
+  }
+  size_t strings = 0;
+  FOR_EACH_RANGE (i, 0, iters) {
+    for (const auto& d : v) {
+      strings += d.is_of<std::string>();
+    }
+  }
+  folly::doNotOptimizeAway(strings);
+}
+
+BENCHMARK_PARAM(DynamicIsOf, 100000);
+
+void DynamicSort(int iters, size_t size) {
+  FOR_EACH_RANGE (i, 0, iters) {
+    vector_dynamic_t ints;
+    vector_dynamic_t strings;
+    BENCHMARK_SUSPEND {
+      FOR_EACH_RANGE (j, 0, size) {
+        ints.emplace_back(int64_t((j * 7919) % size));
+        strings.emplace_back(folly::to<std::string>((j * 7919) % size));
+      }
+    }
+    std::sort(ints.begin(), ints.end());
+    std::sort(strings.begin(), strings.end());
+  }
+}
+
+BENCHMARK_PARAM(DynamicSort, 10000);
+BENCHMARK_PARAM(DynamicSort, 100000);
+
+vector_dynamic_t mapRows(size_t size) {
+  vector_dynamic_t rows;
+  FOR_EACH_RANGE (i, 0, size) {
+    rows.emplace_back(ordered_map_t{{"some_int", int64_t((i * 7919) % size)},
+                                    {"some_str", "foo"}});
+  }
+  return rows;
+}
+
+void DynamicCopyRows(int iters, size_t size) {
+  dynamic rows;
+  BENCHMARK_SUSPEND {
+    rows = mapRows(size);
+  }
+  FOR_EACH_RANGE (i, 0, iters) {
+    folly::doNotOptimizeAway(dynamic(rows));
+  }
+}
+
+BENCHMARK_PARAM(DynamicCopyRows, 10000);
+
+void DynamicSortMaps(int iters, size_t size) {
+  FOR_EACH_RANGE (i, 0, iters) {
+    vector_dynamic_t rows;
+    BENCHMARK_SUSPEND {
+      rows = mapRows(size);
+    }
+    std::sort(rows.begin(), rows.end());
+  }
+}
+
+BENCHMARK_PARAM(DynamicSortMaps, 10000);
+
+void DynamicMerge(int iters, size_t size) {
+  vector_dynamic_t rows;
+  BENCHMARK_SUSPEND {
+    FOR_EACH_RANGE (i, 0, size) {
+      rows.emplace_back(ordered_map_t{{"some_int", int64_t(i)},
+                                      {"some_double", 0.5}});
+    }
+  }
+  FOR_EACH_RANGE (i, 0, iters) {
+    dynamic total = ordered_map_t();
+    for (const auto& row : rows) {
+      total.merge(row);
+    }
+    folly::doNotOptimizeAway(total);
+  }
+}
+
+BENCHMARK_PARAM(DynamicMerge, 10000);
+
+std::string jsonRows(size_t size) {
+  std::string json = "[";
+  FOR_EACH_RANGE (i, 0, size) {
+    json += folly::to<std::string>(i ? "," : "", R"({"some_int": )", i,
+                                   R"(, "some_str": "foo bar baz"})");
+  }
+  return json + "]";
+}
+
+void DynamicFromJson(int iters, size_t size) {
+  std::string json;
+  JsonShapes shapes;
+  JsonParseOptions options;
+  BENCHMARK_SUSPEND {
+    json = jsonRows(size);
+    options.borrowStrings = true;
+    options.shapes = &shapes;
+  }
+  FOR_EACH_RANGE (i, 0, iters) {
+    folly::doNotOptimizeAway(fromJson(json, options));
+  }
+}
+
+BENCHMARK_PARAM(DynamicFromJson, 10000);
+
+void FollyParseJsonToDynamic(int iters, size_t size) {
+  std::string json;
+  BENCHMARK_SUSPEND {
+    json = jsonRows(size);
+  }
+  FOR_EACH_RANGE (i, 0, iters) {
+    folly::doNotOptimizeAway(dynamic(folly::parseJson(json)));
+  }
+}
+
+BENCHMARK_PARAM(FollyParseJsonToDynamic, 10000);
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   auto ret = RUN_ALL_TESTS();
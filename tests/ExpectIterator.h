@@ -3,7 +3,9 @@
 #include <folly/io/async/EventBaseManager.h>
 #include <gtest/gtest.h>
 
+#include "iterlib/FutureIterator.h"
 #include "iterlib/Iterator.h"
+#include "iterlib/WrappedIterator.h"
 
 namespace iterlib {
 
@@ -24,4 +26,51 @@ void ExpectIterator(Iterator* it, const std::vector<T>& expected) {
   EXPECT_FALSE(it->next()) << "Iterator returned more results than expected";
 }
 
+const std::vector<ItemOptimized> kRows{{
+  {1, 0, variant::unordered_map_t{{"a", 1L}}},
+  {2, 0, variant::unordered_map_t{{"a", 2L}}},
+  {3, 0, variant::unordered_map_t{{"a", 3L}}},
+  {4, 0, variant::unordered_map_t{{"a", 4L}}},
+}};
+
+// Source of kRows that counts how many times it was fetched
+inline Iterator* countingSource(int* fetches) {
+  return new FutureIterator<ItemOptimized>(
+      [fetches](const AttributeNameVec*) {
+        (*fetches)++;
+        return folly::makeFuture(kRows);
+      });
+}
+
+// Not cacheable, values are only valid until the next call to next(),
+// rewinds its child if rewindable is set
+class UnstableIterator : public detail::WrappedIterator<> {
+ public:
+  explicit UnstableIterator(Iterator* iter, bool rewindable = false)
+      : detail::WrappedIterator<>(iter), rewindable_(rewindable) {}
+
+  int resets = 0;
+
+ protected:
+  bool doNext() override { return innerIter_->next(); }
+
+  bool doReset() override {
+    if (!rewindable_ || !innerIter_->reset()) {
+      return false;
+    }
+    resets++;
+    return true;
+  }
+
+ private:
+  const bool rewindable_;
+};
+
+inline void prepare(Iterator* it) {
+  ASSERT_FALSE(it->prepare()
+                   .waitVia(folly::EventBaseManager::get()->getEventBase())
+                   .getTry()
+                   .hasException());
+}
+
 } // namespace iterlib
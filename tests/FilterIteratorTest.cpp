@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 
+#include <map>
+
 #include "ExpectIterator.h"
 
 #include "iterlib/FilterIterator.h"
 #include "iterlib/FutureIterator.h"
+#include "iterlib/StringMatcher.h"
 
 using std::unique_ptr;
 using namespace iterlib;
@@ -157,6 +160,54 @@ TEST(FilterContains, Simple) {
   ExpectIterator(filterIt.get(), expectedRes);
 }
 
+TEST(StringMatcher, MatchesLikeStringPiece) {
+  // Needles around the 16 byte block size, haystacks with partial matches
+  // at block boundaries and NUL bytes
+  const std::vector<std::string> needles{
+      "", "a", "ab", "aab", std::string("a\0b", 3), "abcdefghijklmno",
+      "abcdefghijklmnop", "abcdefghijklmnopq", "zzzzzzzzzzzzzzzzzzzzzz"};
+  std::vector<std::string> haystacks{"", "a", "b", "aaab", "xyz"};
+  const std::string alphabet = "abcdefghijklmnopq";
+  for (size_t len = 1; len < 40; len++) {
+    std::string s;
+    for (size_t i = 0; i < len; i++) {
+      s.push_back(i % 5 == 4 ? '\0' : alphabet[(i * 7) % 3]);
+    }
+    haystacks.push_back(s);
+    haystacks.push_back(std::string(len, 'a') + "ab");
+    haystacks.push_back(std::string(len, 'x') + alphabet);
+  }
+  for (const auto& needle : needles) {
+    StringMatcher prefix(needle, FilterType::PREFIX);
+    StringMatcher contains(needle, FilterType::CONTAINS);
+    for (const auto& h : haystacks) {
+      const folly::StringPiece sp(h);
+      EXPECT_EQ(sp.startsWith(needle), prefix.match(sp)) << needle << " " << h;
+      EXPECT_EQ(sp.find(needle), contains.find(sp)) << needle << " " << h;
+    }
+  }
+  EXPECT_THROW(StringMatcher("a", FilterType::EQ), std::invalid_argument);
+}
+
+TEST(StringMatcher, Columns) {
+  StringMatcher matcher("oo", FilterType::CONTAINS);
+  std::vector<uint32_t> out;
+  const auto pieces = std::vector<folly::StringPiece>{"foo", "bar", "boo"};
+  EXPECT_EQ(2, matcher.matchColumn(dynamic(pieces), &out));
+  EXPECT_EQ((std::vector<uint32_t>{0, 2}), out);
+
+  out.clear();
+  const auto mixed = vector_dynamic_t{
+      dynamic("bar"), dynamic(1L), dynamic("moo"),
+      dynamic(folly::StringPiece("food"))};
+  EXPECT_EQ(2, matcher.matchColumn(dynamic(mixed), &out));
+  EXPECT_EQ((std::vector<uint32_t>{2, 3}), out);
+
+  out.clear();
+  EXPECT_EQ(0, matcher.matchColumn(dynamic(std::vector<int64_t>{1, 2}), &out));
+  EXPECT_TRUE(out.empty());
+}
+
 TEST(FilterIteratorTest, InsetOneElement) {
   const auto res = std::vector<ItemOptimized>{
       {1, 0, unordered_map_t{{"field", std::string{"bar"}}}},
@@ -189,6 +240,264 @@ TEST(FilterIteratorTest, InsetManyElements) {
   ExpectIterator(filterIt.get(), expectedRes);
 }
 
+TEST(FilterIteratorTest, InsetLargeSets) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 1000; i++) {
+    res.emplace_back(i, 0,
+                     unordered_map_t{{"int", i * 3},
+                                     {"string", folly::to<std::string>(i)},
+                                     {"double", i * 0.5}});
+  }
+  // Every 7th row by attribute, as strings to be converted
+  std::vector<dynamic> ints;
+  std::vector<dynamic> strings;
+  std::vector<dynamic> ids;
+  std::vector<ItemOptimized> expectedRes;
+  for (int64_t i = 0; i < 1000; i += 7) {
+    ints.emplace_back(folly::to<std::string>(i * 3));
+    // Values in between rows never match
+    ints.emplace_back(folly::to<std::string>(i * 3 + 1));
+    strings.emplace_back(folly::to<std::string>(i));
+    ids.emplace_back(i);
+    expectedRes.push_back(res[i]);
+  }
+  std::reverse(ints.begin(), ints.end());
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int"}, ints, FilterType::INSET);
+  ExpectIterator(filterIt.get(), expectedRes);
+
+  it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"string"}, strings, FilterType::INSET);
+  ExpectIterator(filterIt.get(), expectedRes);
+
+  it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({":id"}, ids, FilterType::EQ);
+  ExpectIterator(filterIt.get(), expectedRes);
+
+  it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"double"}, {0.5, 2.0, 7L}, FilterType::INSET);
+  ExpectIterator(filterIt.get(),
+                 std::vector<ItemOptimized>{res[1], res[4]});
+}
+
+TEST(FilterIteratorTest, AndOrNot) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, unordered_map_t{{"int1", 1L}, {"string", std::string{"foo"}}}},
+      {2, 0, unordered_map_t{{"int1", 2L}, {"string", std::string{"bar"}}}},
+      {3, 0, unordered_map_t{{"int1", 3L}, {"string", std::string{"foo"}}}},
+      {4, 0, unordered_map_t{{"int1", 4L}}},
+  };
+  const auto expectedRes = std::vector<ItemOptimized>{res[1], res[3]};
+
+  // (int1 > 1 AND NOT string = foo) OR :id < 1
+  std::vector<std::unique_ptr<Predicate>> andTerms;
+  andTerms.push_back(Predicate::compile({"int1"}, {"1"}, FilterType::GT));
+  andTerms.push_back(Predicate::makeNot(
+      Predicate::compile({"string"}, {"foo"}, FilterType::EQ)));
+  std::vector<std::unique_ptr<Predicate>> orTerms;
+  orTerms.push_back(Predicate::makeAnd(std::move(andTerms)));
+  orTerms.push_back(Predicate::compile({":id"}, {"1"}, FilterType::LT));
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setPredicate(Predicate::makeOr(std::move(orTerms)));
+  ExpectIterator(filterIt.get(), expectedRes);
+}
+
+TEST(FilterIteratorTest, AddFilter) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, unordered_map_t{{"int1", 15L}, {"int2", 6L}}},
+      {2, 0, unordered_map_t{{"int1", 10L}, {"int2", 3L}}},
+      {3, 0, unordered_map_t{{"int1", 12L}, {"int2", 5L}}},
+      {4, 0, unordered_map_t{{"int1", 5L}, {"int2", 4L}}},
+  };
+  const auto expectedRes = std::vector<ItemOptimized>{res[2]};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int1"}, {"10", "14"}, FilterType::RANGE);
+  filterIt->addFilter({"int2"}, {"4"}, FilterType::GE);
+  ExpectIterator(filterIt.get(), expectedRes);
+}
+
+TEST(FilterIteratorTest, ChainCollapses) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, unordered_map_t{{"int1", 15L}, {"int2", 6L}}},
+      {2, 0, unordered_map_t{{"int1", 10L}, {"int2", 3L}}},
+      {3, 0, unordered_map_t{{"int1", 12L}, {"int2", 5L}}},
+  };
+  const auto expectedRes = std::vector<ItemOptimized>{res[0], res[2]};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto* source = it.get();
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int1"}, {"10"}, FilterType::GT);
+  auto filterIt2 = folly::make_unique<FilterIterator>(filterIt.release());
+  filterIt2->setFilter({"int2"}, {"3"}, FilterType::GT);
+  ExpectIterator(filterIt2.get(), expectedRes);
+  // Both predicates now run in the outer iterator
+  EXPECT_EQ(source, filterIt2->getInnerIterator());
+}
+
+namespace {
+// Also drops odd ids, on top of its predicate
+class EvenIdFilter : public FilterIterator {
+ public:
+  using FilterIterator::FilterIterator;
+
+ protected:
+  bool match(const Iterator* iter) override {
+    return iter->id() % 2 == 0 && FilterIterator::match(iter);
+  }
+};
+}
+
+TEST(FilterIteratorTest, SubclassesAreNotFolded) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, unordered_map_t{{"int1", 15L}}},
+      {2, 0, unordered_map_t{{"int1", 12L}}},
+      {3, 0, unordered_map_t{{"int1", 5L}}},
+  };
+  const auto expectedRes = std::vector<ItemOptimized>{res[1]};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto evenIt = folly::make_unique<EvenIdFilter>(it.release());
+  evenIt->setFilter({"int1"}, {"10"}, FilterType::GT);
+  auto* even = evenIt.get();
+  auto filterIt = folly::make_unique<FilterIterator>(evenIt.release());
+  filterIt->setFilter({"int1"}, {"20"}, FilterType::LT);
+  ExpectIterator(filterIt.get(), expectedRes);
+  EXPECT_EQ(even, filterIt->getInnerIterator());
+}
+
+TEST(FilterIteratorTest, MissingAttribute) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, unordered_map_t{{"int1", 1L}}},
+      {2, 0, unordered_map_t{{"int2", 2L}}},
+      {3, 0, unordered_map_t{{"int1", 3L}}},
+  };
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int1"}, {"2"}, FilterType::LT);
+  ExpectIterator(filterIt.get(), std::vector<ItemOptimized>{res[0]});
+
+  // NE matches rows without the attribute
+  it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int1"}, {"1"}, FilterType::NE);
+  ExpectIterator(filterIt.get(), std::vector<ItemOptimized>{res[1], res[2]});
+
+  it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"int2"}, {}, FilterType::EXISTS);
+  ExpectIterator(filterIt.get(), std::vector<ItemOptimized>{res[1]});
+}
+
+TEST(FilterIteratorTest, VectorPairRows) {
+  const std::vector<std::string> keys{"a", "b"};
+  const std::vector<std::string> otherKeys{"b"};
+  const auto res = std::vector<ItemOptimized>{
+      {1, 0, vector_pair_t{&keys, {dynamic(1L), dynamic(5L)}}},
+      {2, 0, vector_pair_t{&keys, {dynamic(2L), dynamic(1L)}}},
+      {3, 0, vector_pair_t{&otherKeys, {dynamic(7L)}}},
+      {4, 0, vector_pair_t{&keys, {dynamic(3L), dynamic(9L)}}},
+  };
+  const auto expectedRes = std::vector<ItemOptimized>{res[0], res[2], res[3]};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({"b"}, {"2"}, FilterType::GE);
+  ExpectIterator(filterIt.get(), expectedRes);
+}
+
+namespace {
+
+class BoundsRecordingIterator : public FutureIterator<ItemOptimized> {
+ public:
+  using FutureIterator<ItemOptimized>::FutureIterator;
+
+  bool pushDownRange(const std::string& attribute, int64_t min,
+                     int64_t max) override {
+    bounds[attribute] = std::make_pair(min, max);
+    return true;
+  }
+
+  std::map<std::string, std::pair<int64_t, int64_t>> bounds;
+};
+
+}
+
+TEST(FilterIteratorTest, PushDownRange) {
+  const auto res = std::vector<ItemOptimized>{
+      {1, 10, unordered_map_t{{"int1", 1L}}},
+      {2, 20, unordered_map_t{{"int1", 2L}}},
+      {3, 30, unordered_map_t{{"int1", 3L}}},
+      {4, 40, unordered_map_t{{"int1", 4L}}},
+  };
+
+  auto it = folly::make_unique<BoundsRecordingIterator>(folly::makeFuture(res));
+  auto* source = it.get();
+  auto filterIt = folly::make_unique<FilterIterator>(it.release());
+  filterIt->setFilter({":time"}, {"15", "30"}, FilterType::RANGE);
+  filterIt->addFilter({":id"}, {1L, 3L, 4L}, FilterType::INSET);
+  filterIt->addFilter({"int1"}, {"0"}, FilterType::GT);
+  ExpectIterator(filterIt.get(), std::vector<ItemOptimized>{res[2]});
+
+  using Bounds = std::pair<int64_t, int64_t>;
+  EXPECT_EQ(2, source->bounds.size());
+  EXPECT_EQ(Bounds(15, 30), source->bounds[":time"]);
+  EXPECT_EQ(Bounds(1, 4), source->bounds[":id"]);
+
+  // OR takes the union, NOT and unrelated attributes don't bound
+  std::vector<std::unique_ptr<Predicate>> terms;
+  terms.push_back(Predicate::compile({":time"}, {"10"}, FilterType::LT));
+  terms.push_back(Predicate::compile({":time"}, {"35"}, FilterType::GE));
+  terms.push_back(Predicate::compile({":time"}, {"50"}, FilterType::GT));
+  auto pred = Predicate::makeOr(std::move(terms));
+  int64_t min = 0;
+  int64_t max = 100;
+  pred->narrowRange(":time", &min, &max);
+  EXPECT_EQ(0, min);
+  EXPECT_EQ(100, max);
+  pred = Predicate::makeAnd(std::move(pred),
+                            Predicate::compile({":time"}, {"20"},
+                                               FilterType::GE));
+  pred->narrowRange(":time", &min, &max);
+  EXPECT_EQ(20, min);
+  EXPECT_EQ(100, max);
+  pred = Predicate::makeNot(std::move(pred));
+  pred->narrowRange(":id", &min, &max);
+  EXPECT_EQ(20, min);
+}
+
+TEST(FilterIteratorTest, InvalidArity) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(std::vector<ItemOptimized>{}));
+  FilterIterator filterIt(it.release());
+  EXPECT_THROW(filterIt.setFilter({"a", "b"}, {1L, 2L, 3L}, FilterType::GT),
+               std::invalid_argument);
+  EXPECT_THROW(filterIt.setFilter({"a"}, {1L}, FilterType::RANGE),
+               std::invalid_argument);
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
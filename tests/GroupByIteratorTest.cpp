@@ -46,6 +46,33 @@ TEST(GroupByIterator, ExceptionOnInvalidAttribute) {
       << "Grouping by non existing field should throw";
 }
 
+TEST(GroupByIterator, VectorPairRows) {
+  const std::vector<std::string> keys1{"int1", "int2"};
+  const std::vector<std::string> keys2{"int2", "int1"};
+  const auto res = std::vector<ItemOptimized>{{
+      {1, 0, vector_pair_t{&keys1, {1L, 2L}}},
+      {2, 0, vector_pair_t{&keys2, {3L, 2L}}},
+      {3, 0, vector_pair_t{&keys1, {1L, 3L}}},
+  }};
+  const auto groupedResult =
+      std::vector<std::vector<const Item*>>{{{&res[0], &res[2]}, {&res[1]}}};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto groupByIt = GroupByIterator{it.release(), {"int1"}};
+
+  ExpectGroupByIterator(std::move(groupByIt), Item{vector_dynamic_t{{"int1"}}},
+                        groupedResult);
+
+  const std::vector<std::string> keys3{"int2"};
+  auto missing = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(std::vector<ItemOptimized>{
+          {1, 0, vector_pair_t{&keys3, {1L}}}}));
+  auto missingIt = GroupByIterator(missing.release(), {"int1"});
+  missingIt.prepare().waitVia(folly::EventBaseManager::get()->getEventBase());
+  EXPECT_THROW(missingIt.next(), std::out_of_range);
+}
+
 TEST(GroupByIterator, GroupByOneAttr) {
   const auto res = std::vector<ItemOptimized>{{
       {1, 0, ordered_map_t{{"int1", 1L}, {"int2", 2L}}},
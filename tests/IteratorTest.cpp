@@ -4,11 +4,16 @@
 //  of patent rights can be found in the PATENTS file in the same directory.
 #include "ExpectIterator.h"
 
+#include <folly/json.h>
+#include <limits>
+#include <set>
+
 #include "iterlib/FutureIterator.h"
 #include "iterlib/LimitIterator.h"
 #include "iterlib/RandomIterator.h"
 #include "iterlib/ReverseIterator.h"
 #include "iterlib/CountIterator.h"
+#include "iterlib/ProjectIterator.h"
 
 #include "iterlib/AndIterator.h"
 #include "iterlib/OrIterator.h"
@@ -62,10 +67,68 @@ TEST(IteratorTest, ReverseIterator) {
   auto it =
       folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
   auto reverseIt = folly::make_unique<ReverseIterator>(it.release());
-  const auto expected = std::vector<Item>{res[3], res[2], res[1], res[0]};
+  const auto expected =
+      std::vector<ItemOptimized>{res[3], res[2], res[1], res[0]};
   ExpectIterator(reverseIt.get(), expected);
 }
 
+// (->> (json_literal ..)
+//      (reverse)
+//      (project ..)
+//      (limit 2 :offset 1))
+TEST(IteratorTest, LimitIteratorOffset) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 1; i <= 5; i++) {
+    res.emplace_back(i, 0, unordered_map_t{{"int1", i}});
+  }
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto reverseIt = folly::make_unique<ReverseIterator>(it.release());
+  auto projectIt = folly::make_unique<ProjectIterator>(
+      reverseIt.release(), AttributeNameVec{"int1"});
+  LimitIterator limitIt(projectIt.release(), 2, 1);
+  limitIt.prepare();
+  std::vector<int64_t> actual;
+  while (limitIt.next()) {
+    actual.push_back(limitIt.value().at("int1").get<int64_t>());
+  }
+  EXPECT_EQ((std::vector<int64_t>{4, 3}), actual);
+
+  // Skipping past the end
+  for (auto skip : {5, 6}) {
+    auto past =
+        folly::make_unique<FutureIterator<ItemOptimized>>(
+            folly::makeFuture(res));
+    auto reversed = folly::make_unique<ReverseIterator>(past.release());
+    reversed->prepare();
+    EXPECT_EQ(skip == 5, reversed->skip(skip));
+    EXPECT_EQ(skip != 5, reversed->done());
+  }
+}
+
+TEST(IteratorTest, LimitIteratorEstimate) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 1; i <= 5; i++) {
+    res.emplace_back(i, 0, unordered_map_t{{"int1", i}});
+  }
+  auto estimate = [&](Iterator* inner, size_t count, size_t offset) {
+    LimitIterator limitIt(inner, count, offset);
+    limitIt.prepare();
+    return limitIt.estimateRemaining();
+  };
+  auto source = [&] {
+    return new FutureIterator<ItemOptimized>(folly::makeFuture(res));
+  };
+  EXPECT_EQ(2, estimate(source(), 2, 1));
+  EXPECT_EQ(1, estimate(source(), 10, 4));
+  EXPECT_EQ(0, estimate(source(), 2, 7));
+  EXPECT_EQ(0, estimate(source(), 2, std::numeric_limits<size_t>::max()));
+  EXPECT_EQ(5, estimate(source(), std::numeric_limits<size_t>::max(), 0));
+  // Unknown stays unknown
+  EXPECT_EQ(-1, estimate(new UnstableIterator(source()), 2, 1));
+}
+
 TEST(IteratorTest, RandomIterator) {
   const auto res = std::vector<ItemOptimized>{
       {1, 0, ordered_map_t{{"int1", 2L},
@@ -91,6 +154,33 @@ TEST(IteratorTest, RandomIterator) {
   EXPECT_FALSE(randomIt->next());
 }
 
+TEST(IteratorTest, RandomIteratorIsUniform) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 50; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+
+  // Each row is expected in 2000 * 5 / 50 = 200 samples
+  std::vector<int> hits(res.size());
+  for (int trial = 0; trial < 2000; trial++) {
+    RandomIterator it(
+        new FutureIterator<ItemOptimized>(folly::makeFuture(res)), 5);
+    it.prepare();
+    std::set<int64_t> sample;
+    while (it.next()) {
+      sample.insert(it.value().at("int1").get<int64_t>());
+    }
+    ASSERT_EQ(5, sample.size());
+    for (auto i : sample) {
+      hits[i]++;
+    }
+  }
+  for (auto n : hits) {
+    EXPECT_GT(n, 120);
+    EXPECT_LT(n, 280);
+  }
+}
+
 TEST(IteratorTest, CountIterator) {
   const auto res = std::vector<ItemOptimized>{
       {1, 0, unordered_map_t{{"int1", 2L},
@@ -117,6 +207,135 @@ TEST(IteratorTest, CountIterator) {
   EXPECT_FALSE(countIt->next());
 }
 
+TEST(IteratorTest, CountIteratorEmpty) {
+  auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(std::vector<ItemOptimized>{}));
+  auto countIt = folly::make_unique<CountIterator>(it.release());
+  countIt->prepare();
+  EXPECT_TRUE(countIt->next());
+  EXPECT_EQ(0, countIt->value());
+  EXPECT_FALSE(countIt->next());
+}
+
+// (->> (json_literal ..)
+//      (project [int1])
+//      (limit offset count)
+//      (count))
+TEST(IteratorTest, CountIteratorPushdown) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 10; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+  const auto expected = std::vector<std::tuple<size_t, size_t, int64_t>>{
+      std::make_tuple(3, 0, 3),
+      std::make_tuple(3, 8, 2),
+      std::make_tuple(20, 4, 6),
+      std::make_tuple(5, 10, 0),
+      std::make_tuple(5, 20, 0),
+  };
+  for (const auto& e : expected) {
+    auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+        folly::makeFuture(res));
+    auto projectIt = folly::make_unique<ProjectIterator>(
+        it.release(), AttributeNameVec{"int1"});
+    auto limitIt = folly::make_unique<LimitIterator>(
+        projectIt.release(), std::get<0>(e), std::get<1>(e));
+    auto countIt = folly::make_unique<CountIterator>(limitIt.release());
+    countIt->prepare();
+    EXPECT_TRUE(countIt->next());
+    EXPECT_EQ(std::get<2>(e), countIt->value());
+    EXPECT_FALSE(countIt->next());
+  }
+}
+
+TEST(IteratorTest, CountIteratorCap) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 4; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+  // cap, count, truncated
+  const auto expected = std::vector<std::tuple<size_t, int64_t, bool>>{
+      std::make_tuple(0, 0, true),
+      std::make_tuple(2, 2, true),
+      std::make_tuple(4, 4, false),
+      std::make_tuple(10, 4, false),
+  };
+  for (const auto& e : expected) {
+    auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+        folly::makeFuture(res));
+    // Filter-like wrapper without countRemaining(), forces iteration
+    auto reverseIt = folly::make_unique<ReverseIterator>(it.release());
+    auto countIt =
+        folly::make_unique<CountIterator>(reverseIt.release(), std::get<0>(e));
+    countIt->prepare();
+    EXPECT_TRUE(countIt->next());
+    EXPECT_EQ(std::get<1>(e), countIt->value());
+    EXPECT_EQ(std::get<2>(e), countIt->truncated());
+    EXPECT_FALSE(countIt->estimated());
+    EXPECT_FALSE(countIt->next());
+  }
+}
+
+TEST(IteratorTest, CountIteratorEstimate) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 10; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+  // Estimates at or under the cap are replaced by an exact count
+  const auto expected = std::vector<std::tuple<size_t, int64_t, bool>>{
+      std::make_tuple(CountIterator::kNoCap, 7, true),
+      std::make_tuple(5, 7, true),
+      std::make_tuple(7, 7, false),
+  };
+  for (const auto& e : expected) {
+    auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+        folly::makeFuture(res));
+    auto limitIt = folly::make_unique<LimitIterator>(it.release(), 20, 3);
+    auto countIt = folly::make_unique<CountIterator>(
+        limitIt.release(), std::get<0>(e), CountMode::ESTIMATE);
+    countIt->prepare();
+    EXPECT_TRUE(countIt->next());
+    EXPECT_EQ(std::get<1>(e), countIt->value());
+    EXPECT_EQ(std::get<2>(e), countIt->estimated());
+    EXPECT_FALSE(countIt->truncated());
+    EXPECT_FALSE(countIt->next());
+  }
+}
+
+TEST(IteratorTest, CountRemainingKeepsPosition) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 10; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+  std::unique_ptr<Iterator> it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(
+          folly::makeFuture(res));
+  it->prepare();
+  EXPECT_TRUE(it->next());
+  EXPECT_EQ(3, it->countRemaining(3));
+  EXPECT_TRUE(it->next());
+  EXPECT_EQ(4, it->id());
+  EXPECT_EQ(5, it->countRemaining());
+  EXPECT_FALSE(it->next());
+}
+
+TEST(IteratorTest, SkipByIndex) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 10; i++) {
+    res.emplace_back(i, 0, ordered_map_t{{"int1", i}});
+  }
+  std::unique_ptr<Iterator> it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(
+          folly::makeFuture(res));
+  it->prepare();
+  EXPECT_TRUE(it->skip(3));
+  EXPECT_EQ(2, it->id());
+  EXPECT_TRUE(it->skip(7));
+  EXPECT_EQ(9, it->id());
+  EXPECT_FALSE(it->skip(1));
+  EXPECT_TRUE(it->done());
+}
+
 // returns [end, start] in descending order
 std::unique_ptr<Iterator> getRange(int64_t start, int64_t end) {
   std::vector<ItemOptimized> res;
@@ -157,6 +376,63 @@ TEST(IteratorTest, UnionIterator) {
   EXPECT_FALSE(it3->next());
 }
 
+// (->> (union (json_literal ..) (json_literal ..))
+//      (limit 9 :offset 1))
+std::unique_ptr<Iterator> getUnionPage() {
+  IteratorVector iters;
+  iters.emplace_back(getVector({10, 9, 8, 7, 6, 5, 4, 3, 2, 1}));
+  iters.emplace_back(getVector({14, 12, 10, 7, 5, 2}));
+  return folly::make_unique<LimitIterator>(new UnionIterator(iters), 9, 1);
+}
+
+TEST(IteratorTest, ResumeFromCursor) {
+  std::vector<iterlib::id_t> expected;
+  auto all = getUnionPage();
+  all->prepare();
+  while (all->next()) {
+    expected.push_back(all->id());
+  }
+  ASSERT_EQ(9, expected.size());
+
+  // Pages of 4 rows, the cursor goes through JSON like it would to a client
+  std::vector<iterlib::id_t> actual;
+  std::string cursor;
+  for (int page = 0; page < 3; page++) {
+    auto it = getUnionPage();
+    if (!cursor.empty()) {
+      iterlib::dynamic saved(folly::parseJson(cursor));
+      ASSERT_TRUE(it->restoreCursor(saved));
+    }
+    it->prepare();
+    for (int i = 0; i < 4 && it->next(); i++) {
+      actual.push_back(it->id());
+    }
+    iterlib::dynamic saved;
+    ASSERT_TRUE(it->saveCursor(&saved));
+    cursor = saved.toJson();
+  }
+  EXPECT_EQ(expected, actual);
+
+  // Rewinding returns the current row again
+  auto it = getUnionPage();
+  it->prepare();
+  ASSERT_TRUE(it->next());
+  ASSERT_TRUE(it->next());
+  iterlib::dynamic saved;
+  ASSERT_TRUE(it->saveCursor(&saved, true));
+  auto resumed = getUnionPage();
+  ASSERT_TRUE(resumed->restoreCursor(saved));
+  resumed->prepare();
+  for (size_t i = 1; i < expected.size(); i++) {
+    ASSERT_TRUE(resumed->next());
+    EXPECT_EQ(expected[i], resumed->id());
+  }
+  EXPECT_FALSE(resumed->next());
+
+  EXPECT_THROW(getUnionPage()->restoreCursor(iterlib::dynamic(1L)),
+               std::invalid_argument);
+}
+
 TEST(IteratorTest, ConcatIterator) {
   auto it1 = std::move(getVector({3, 5, 2, 1}));
   auto it2 = std::move(getVector({4, 2, 1}));
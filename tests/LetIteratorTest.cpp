@@ -4,10 +4,12 @@
 
 #include "iterlib/FutureIterator.h"
 #include "iterlib/LetIterator.h"
+#include "iterlib/ProjectIterator.h"
 
 using namespace iterlib;
 using iterlib::variant::unordered_map_t;
 using iterlib::variant::ordered_map_t;
+using iterlib::variant::dynamic_ref;
 
 TEST(LetIterator, basic) {
   const auto res = std::vector<ItemOptimized>{{
@@ -28,6 +30,54 @@ TEST(LetIterator, basic) {
   ExpectIterator(it.get(), expected);
 }
 
+TEST(LetIterator, ChainsAliasTheSource) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 0, unordered_map_t{{"a", 1L}, {"b", 10L}, {":time", 5L}}},
+  }};
+
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto* source = inner.get();
+  auto let = folly::make_unique<LetIterator>(inner.release(), "c", "a");
+  auto it = folly::make_unique<LetIterator>(let.release(), ":time", "b");
+  it->prepare();
+
+  ASSERT_TRUE(it->next());
+  const auto& value = it->value();
+  ASSERT_TRUE(value.is_of<dynamic_ref>());
+  // One view of the source row, not a view of a view
+  EXPECT_EQ(&source->value().value(), value.getRef<dynamic_ref>().target);
+  EXPECT_EQ(&source->value().at("a"), &value.at("c"));
+  EXPECT_THROW(value.at("a"), std::out_of_range);
+  EXPECT_EQ(dynamic(10L), value.at(":time"));
+  EXPECT_EQ(10, it->value().ts());
+  EXPECT_EQ(1, it->value().id());
+  EXPECT_EQ(dynamic(ordered_map_t{{"c", 1L}, {":time", 10L}}),
+            value.value());
+  // Orders like the renamed copy would, although the source is unordered
+  EXPECT_LT(value.value(), dynamic(ordered_map_t{{"c", 2L}}));
+  EXPECT_FALSE(dynamic(ordered_map_t{{"c", 1L}, {":time", 10L}}) <
+               value.value());
+  EXPECT_FALSE(it->next());
+}
+
+TEST(LetIterator, CopiesUnstableRows) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 0, unordered_map_t{{"a", 1L}, {"b", 10L}}},
+  }};
+  // Projected rows are rebuilt in place, so they must be copied
+  const auto expected = std::vector<ItemOptimized>{{
+    {1, 0, ordered_map_t{{"c", 1L}}},
+  }};
+
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto project = folly::make_unique<ProjectIterator>(
+    inner.release(), AttributeNameVec{"a"});
+  auto it = folly::make_unique<LetIterator>(project.release(), "c", "a");
+  ExpectIterator(it.get(), expected);
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,92 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+#include <gtest/gtest.h>
+
+#include "ExpectIterator.h"
+
+#include "iterlib/LimitIterator.h"
+#include "iterlib/MaterializeIterator.h"
+
+using namespace iterlib;
+
+namespace {
+
+// Copies of unstable rows are Items, so only their values are compared
+void expectRows(Iterator* it, const std::vector<ItemOptimized>& rows) {
+  for (const auto& row : rows) {
+    ASSERT_TRUE(it->next());
+    EXPECT_EQ(row.value(), it->value().value());
+  }
+  EXPECT_FALSE(it->next());
+  EXPECT_TRUE(it->done());
+}
+
+}
+
+TEST(MaterializeIterator, ReplaysCache) {
+  int fetches = 0;
+  auto* source = new UnstableIterator(countingSource(&fetches), true);
+  MaterializeIterator iter(source, 1 << 20);
+  EXPECT_TRUE(iter.cacheable());
+  prepare(&iter);
+  expectRows(&iter, kRows);
+  EXPECT_GT(iter.cachedBytes(), 0);
+  for (int pass = 0; pass < 3; pass++) {
+    ASSERT_TRUE(iter.reset());
+    EXPECT_EQ(kRows.size(), iter.estimateRemaining());
+    expectRows(&iter, kRows);
+  }
+  EXPECT_EQ(1, fetches);
+  EXPECT_EQ(0, source->resets);
+}
+
+TEST(MaterializeIterator, ResetDuringFirstPass) {
+  MaterializeIterator iter(
+      new UnstableIterator(
+          new FutureIterator<ItemOptimized>(folly::makeFuture(kRows))),
+      1 << 20);
+  prepare(&iter);
+  ASSERT_TRUE(iter.next());
+  ASSERT_TRUE(iter.reset());
+  expectRows(&iter, kRows);
+  ASSERT_TRUE(iter.reset());
+  expectRows(&iter, kRows);
+}
+
+TEST(MaterializeIterator, OverBudgetRewindsChild) {
+  auto* source = new UnstableIterator(
+      new FutureIterator<ItemOptimized>(folly::makeFuture(kRows)), true);
+  MaterializeIterator iter(source, 1);
+  prepare(&iter);
+  expectRows(&iter, kRows);
+  EXPECT_FALSE(iter.cacheable());
+  EXPECT_EQ(0, iter.cachedBytes());
+  ASSERT_TRUE(iter.reset());
+  EXPECT_EQ(1, source->resets);
+  expectRows(&iter, kRows);
+
+  MaterializeIterator stuck(
+      new UnstableIterator(
+          new FutureIterator<ItemOptimized>(folly::makeFuture(kRows))),
+      1);
+  prepare(&stuck);
+  expectRows(&stuck, kRows);
+  EXPECT_FALSE(stuck.reset());
+  EXPECT_TRUE(stuck.done());
+}
+
+TEST(MaterializeIterator, CacheableChildIsRewound) {
+  int fetches = 0;
+  MaterializeIterator iter(
+      new LimitIterator(countingSource(&fetches), 2, 1), 1 << 20);
+  const std::vector<ItemOptimized> expected{kRows[1], kRows[2]};
+  ExpectIterator(&iter, expected);
+  ASSERT_TRUE(iter.reset());
+  expectRows(&iter, expected);
+  EXPECT_EQ(0, iter.cachedBytes());
+  EXPECT_EQ(1, fetches);
+}
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
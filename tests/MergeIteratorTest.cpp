@@ -8,6 +8,8 @@
 
 using namespace iterlib;
 using iterlib::variant::unordered_map_t;
+using iterlib::variant::vector_dynamic_t;
+using iterlib::variant::vector_pair_t;
 
 TEST(MergeIterator, ints) {
   const std::string countKey = "count";
@@ -63,6 +65,66 @@ TEST(MergeIterator, maps) {
   ExpectIterator(&mergedIt, expected);
 }
 
+TEST(MergeIterator, Strategies) {
+  const auto res = std::vector<ItemOptimized>{{
+      {1, 0, unordered_map_t{{"count", 10L}, {"avg", 1.5}}},
+      {1, 0, unordered_map_t{{"count", 20L}, {"avg", 2.5}}},
+      {2, 0, unordered_map_t{{"count", 30L}}},
+  }};
+  const auto expected = std::vector<ItemOptimized>{{
+      {2, 0, unordered_map_t{{"count", 30L}}},
+      {1, 0, unordered_map_t{{"count", 30L}, {"avg", 4.0}}},
+  }};
+
+  IteratorVector iters;
+  for (const auto& v : res) {
+    std::vector<ItemOptimized> vec = { v };
+    auto it = folly::make_unique<FutureIterator<ItemOptimized>>(
+      folly::makeFuture(vec));
+    iters.emplace_back(it.release());
+  }
+  auto mergedIt = MergeIterator(iters);
+  mergedIt.setDefaultMergeStrategy(MergeStrategy::SUM);
+  ExpectIterator(&mergedIt, expected);
+}
+
+TEST(RowMerger, PerAttributeStrategies) {
+  RowMerger merger;
+  merger.setStrategy("first", MergeStrategy::FIRST_WINS);
+  merger.setStrategy("last", MergeStrategy::LAST_WINS);
+  merger.setStrategy("tags", MergeStrategy::APPEND);
+  merger.setStrategy("count", MergeStrategy::SUM);
+  EXPECT_EQ(MergeStrategy::SUM,
+            merger.strategyFor(folly::StringPiece("count")));
+  EXPECT_EQ(MergeStrategy::DEFAULT, merger.strategyFor("coun"));
+  merger.setStrategy("tags", MergeStrategy::LAST_WINS);
+  merger.setStrategy("tags", MergeStrategy::APPEND);
+
+  dynamic row = unordered_map_t{
+    {"first", 1L}, {"last", 1L}, {"tags", "a"}, {"count", 1L},
+    {"name", "x"}};
+  merger.merge(&row, unordered_map_t{
+    {"first", 2L}, {"last", 2L}, {"tags", vector_dynamic_t{"b", "c"}},
+    {"count", 2.5}, {"name", "y"}, {"new", true}});
+
+  const dynamic expected = unordered_map_t{
+    {"first", 1L}, {"last", 2L}, {"tags", vector_dynamic_t{"a", "b", "c"}},
+    {"count", 3.5}, {"name", "xy"}, {"new", true}};
+  EXPECT_EQ(expected, row);
+
+  dynamic bad = unordered_map_t{{"count", "a"}};
+  EXPECT_THROW(merger.merge(&bad, unordered_map_t{{"count", 1L}}),
+               std::invalid_argument);
+}
+
+TEST(RowMerger, MergesIntoVectorPairs) {
+  const std::vector<std::string> keys{"a", "b"};
+  dynamic row = vector_pair_t{&keys, {1L, 2L}};
+  RowMerger merger;
+  merger.merge(&row, unordered_map_t{{"b", 3L}, {"c", 4L}});
+  EXPECT_EQ(dynamic(unordered_map_t{{"a", 1L}, {"b", 5L}, {"c", 4L}}), row);
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
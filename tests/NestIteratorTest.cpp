@@ -4,11 +4,13 @@
 #include "ExpectIterator.h"
 
 #include "iterlib/FutureIterator.h"
+#include "iterlib/LetIterator.h"
 #include "iterlib/NestIterator.h"
 
 using namespace iterlib;
 using iterlib::variant::unordered_map_t;
 using iterlib::variant::ordered_map_t;
+using iterlib::variant::dynamic_ref;
 
 TEST(NestIterator, basic) {
   const std::string countKey = "count";
@@ -47,6 +49,54 @@ TEST(NestIterator, basic) {
   }
 }
 
+TEST(NestIterator, ReferencesInnerRows) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 5, unordered_map_t{{"count", 10L}}},
+    {2, 6, unordered_map_t{{"count", 20L}}},
+  }};
+
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto* source = inner.get();
+  auto it = folly::make_unique<NestIterator>(inner.release(), "assoc");
+  it->prepare();
+
+  ASSERT_TRUE(it->next());
+  const auto& nested = it->value().at("assoc");
+  ASSERT_TRUE(nested.is_of<dynamic_ref>());
+  EXPECT_EQ(&source->value().value(), nested.getRef<dynamic_ref>().target);
+  EXPECT_EQ(dynamic(10L), it->value().at("assoc").at("count"));
+  EXPECT_EQ("{\"assoc\":{\"count\":10}}", it->value().toJson());
+  EXPECT_EQ(1, it->value().id());
+  EXPECT_EQ(5, it->value().ts());
+
+  ASSERT_TRUE(it->next());
+  EXPECT_EQ(dynamic(20L), it->value().at("assoc").at("count"));
+  EXPECT_FALSE(it->next());
+}
+
+TEST(NestIterator, NestsViews) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 0, unordered_map_t{{"count", 10L}}},
+  }};
+
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto* source = inner.get();
+  auto let = folly::make_unique<LetIterator>(inner.release(), "n", "count");
+  auto it = folly::make_unique<NestIterator>(let.release(), "assoc");
+  it->prepare();
+
+  ASSERT_TRUE(it->next());
+  // The view of the let is copied, not referenced
+  const auto& nested = it->value().at("assoc");
+  ASSERT_TRUE(nested.is_of<dynamic_ref>());
+  EXPECT_EQ(&source->value().value(), nested.getRef<dynamic_ref>().target);
+  EXPECT_EQ(dynamic(10L), nested.at("n"));
+  EXPECT_EQ(dynamic(ordered_map_t{{"n", 10L}}), nested);
+  EXPECT_FALSE(it->next());
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -27,6 +27,41 @@ TEST(OrderByIterator, OrderByOneAttr) {
   ExpectIterator(orderByIt.get(), orderedResult);
 }
 
+TEST(OrderByIterator, Skip) {
+  std::vector<ItemOptimized> res;
+  for (int64_t i = 0; i < 20; i++) {
+    // Duplicate keys come out in input order
+    res.emplace_back(i, 0, ordered_map_t{{"int1", (i * 7) % 10}});
+  }
+
+  std::vector<int64_t> expected;
+  {
+    OrderByIterator it(new FutureIterator<ItemOptimized>(makeFuture(res)),
+                       AttributeNameVec{{"int1"}});
+    it.prepare();
+    while (it.next()) {
+      expected.push_back(it.id());
+    }
+  }
+
+  // Small skips pop the heap, large ones select the rows to drop
+  for (size_t first : {1, 2, 15}) {
+    for (size_t second : {1, 3, 4}) {
+      OrderByIterator it(new FutureIterator<ItemOptimized>(makeFuture(res)),
+                         AttributeNameVec{{"int1"}});
+      it.prepare();
+      ASSERT_TRUE(it.skip(first));
+      EXPECT_EQ(expected[first - 1], it.id());
+      ASSERT_TRUE(it.skip(second));
+      EXPECT_EQ(expected[first + second - 1], it.id());
+      ASSERT_TRUE(it.next());
+      EXPECT_EQ(expected[first + second], it.id());
+      EXPECT_FALSE(it.skip(20));
+      EXPECT_TRUE(it.done());
+    }
+  }
+}
+
 TEST(OrderByIterator, OrderByTwoAttr) {
   const auto res = std::vector<ItemOptimized>{{
       {1, 0, ordered_map_t{{"int1", 1L},
@@ -81,6 +116,29 @@ TEST(OrderByIterator, OrderByTwoAttrMixed) {
   ExpectIterator(orderByIt.get(), orderedResult);
 }
 
+TEST(OrderByIterator, VectorPairRows) {
+  // Rows of two projections, the attributes are at different positions
+  const std::vector<std::string> keys1{"int1", "int2"};
+  const std::vector<std::string> keys2{"int2", "other", "int1"};
+  const auto res = std::vector<ItemOptimized>{{
+      {1, 0, vector_pair_t{&keys1, {1L, 5L}}},
+      {2, 0, vector_pair_t{&keys2, {3L, 0L, 2L}}},
+      {3, 0, vector_pair_t{&keys1, {2L, 4L}}},
+      {4, 0, vector_pair_t{&keys2, {6L, 0L, 1L}}},
+  }};
+  const auto orderedResult =
+      std::vector<ItemOptimized>{{res[1], res[2], res[0], res[3]}};
+
+  auto it =
+      folly::make_unique<FutureIterator<ItemOptimized>>(folly::makeFuture(res));
+  auto orderByIt = folly::make_unique<OrderByIterator>(
+      it.release(), AttributeNameVec{{{"int1"}, {"int2"}}},
+      // int1 descending, int2 ascending
+      std::vector<bool>{{true, false}});
+
+  ExpectIterator(orderByIt.get(), orderedResult);
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -3,21 +3,26 @@
 
 #include "ExpectIterator.h"
 
+#include "iterlib/FilterIterator.h"
 #include "iterlib/FutureIterator.h"
+#include "iterlib/LetIterator.h"
+#include "iterlib/NestIterator.h"
 #include "iterlib/ProjectIterator.h"
 
 using namespace iterlib;
 using iterlib::variant::unordered_map_t;
 using iterlib::variant::ordered_map_t;
+using iterlib::variant::vector_pair_t;
 
 TEST(ProjectIterator, basic) {
   const auto res = std::vector<ItemOptimized>{{
     {1, 0, unordered_map_t{{"a", 1L}, {"b", 10L}, {"c", 20L}}},
     {2, 0, unordered_map_t{{"a", 2L}, {"b", 11L}, {"c", 21L}}},
   }};
+  const std::vector<std::string> keys{"a", "c"};
   const auto expected = std::vector<ItemOptimized>{{
-    {1, 0, ordered_map_t{{"a", 1L}, {"c", 20L}}},
-    {2, 0, ordered_map_t{{"a", 2L}, {"c", 21L}}},
+    {1, 0, vector_pair_t{&keys, {dynamic(1L), dynamic(20L)}}},
+    {2, 0, vector_pair_t{&keys, {dynamic(2L), dynamic(21L)}}},
   }};
 
   auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
@@ -28,6 +33,148 @@ TEST(ProjectIterator, basic) {
   ExpectIterator(it.get(), expected);
 }
 
+TEST(ProjectIterator, ProjectsOncePerRow) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 0, unordered_map_t{{"a", 1L}, {"s", std::string{"foo"}}}},
+    {2, 0, ordered_map_t{{"s", std::string{"bar"}}, {":time", 7L}}},
+  }};
+
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto it = folly::make_unique<ProjectIterator>(
+      inner.release(), AttributeNameVec{"s", "a", ":time"});
+  it->prepare();
+
+  ASSERT_TRUE(it->next());
+  const auto& first = it->value();
+  EXPECT_EQ(&first, &it->value());
+  const auto& pair = first.getRef<vector_pair_t>();
+  const auto* keys = pair.first;
+  EXPECT_EQ((std::vector<std::string>{"s", "a", ":time"}), *keys);
+  // Strings keep their type unless borrowing is enabled
+  EXPECT_EQ("foo", pair.second[0].get<std::string>());
+  EXPECT_EQ(dynamic(1L), pair.second[1]);
+  EXPECT_TRUE(pair.second[2].is_of<boost::blank>());
+  EXPECT_EQ(1, it->id());
+
+  ASSERT_TRUE(it->next());
+  const auto& second = it->value().getRef<vector_pair_t>();
+  EXPECT_EQ(keys, second.first);
+  EXPECT_EQ(dynamic("bar"), second.second[0]);
+  EXPECT_TRUE(second.second[1].is_of<boost::blank>());
+  EXPECT_EQ(7, it->value().ts());
+  EXPECT_FALSE(it->next());
+}
+
+TEST(ProjectIterator, BorrowStrings) {
+  const auto res = std::vector<ItemOptimized>{{
+    {1, 0, unordered_map_t{{"s", std::string{"foo"}}}},
+  }};
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    folly::makeFuture(res));
+  auto* source = inner.get();
+  ProjectIterator it(inner.release(), AttributeNameVec{"s"});
+  it.setBorrowStrings(true);
+  it.prepare();
+  ASSERT_TRUE(it.next());
+  // Strings point into the child's rows
+  const auto& value = it.value().getRef<vector_pair_t>().second[0];
+  ASSERT_TRUE(value.is_of<folly::StringPiece>());
+  EXPECT_EQ(source->value().at("s").getRef<std::string>().data(),
+            value.get<folly::StringPiece>().data());
+}
+
+TEST(ProjectIterator, PushesColumnsDown) {
+  AttributeNameVec requested;
+  auto inner = folly::make_unique<FutureIterator<ItemOptimized>>(
+    [&requested](const AttributeNameVec* columns) {
+      requested = *columns;
+      return folly::makeFuture(std::vector<ItemOptimized>{{
+        {1, 0, unordered_map_t{{"a", 1L}}},
+      }});
+    });
+  auto it = folly::make_unique<ProjectIterator>(
+      inner.release(), AttributeNameVec{"a", ":time"});
+  it->prepare();
+
+  EXPECT_EQ((AttributeNameVec{"a", ":time", ":id"}), requested);
+  ASSERT_TRUE(it->next());
+  EXPECT_EQ(dynamic(1L), it->value().at("a"));
+  EXPECT_FALSE(it->next());
+}
+
+TEST(ProjectIterator, PushesColumnsThroughOperators) {
+  // Records the columns a leaf is asked for, none if it may skip nothing
+  AttributeNameVec requested;
+  auto leaf = [&requested]() {
+    requested.clear();
+    return new FutureIterator<ItemOptimized>(
+        [&requested](const AttributeNameVec* columns) {
+          if (columns != nullptr) {
+            requested = *columns;
+          }
+          return folly::makeFuture(std::vector<ItemOptimized>{{
+            {1, 0, unordered_map_t{{"a", 1L}, {"b", 2L}}},
+          }});
+        });
+  };
+  auto first = [](Iterator* it, const std::string& attribute) {
+    it->prepare();
+    EXPECT_TRUE(it->next());
+    return it->value().at(attribute);
+  };
+
+  // The filter's own attributes are added
+  auto* filter = new FilterIterator(leaf());
+  filter->setFilter({"b"}, {"0"}, FilterType::GT);
+  ProjectIterator overFilter(filter, AttributeNameVec{"a"});
+  EXPECT_EQ(dynamic(1L), first(&overFilter, "a"));
+  EXPECT_EQ((AttributeNameVec{"a", ":id", ":time", "b"}), requested);
+
+  // The renamed attribute is read under its old name
+  ProjectIterator overLet(
+      new LetIterator(leaf(), std::string("x"), std::string("a")),
+      AttributeNameVec{"x"});
+  EXPECT_EQ(dynamic(1L), first(&overLet, "x"));
+  EXPECT_EQ((AttributeNameVec{":id", ":time", "a"}), requested);
+
+  // A nested row is needed whole
+  ProjectIterator overNest(new NestIterator(leaf(), std::string("n")),
+                           AttributeNameVec{"n"});
+  const auto nested = first(&overNest, "n");
+  EXPECT_EQ(dynamic(2L), nested.at("b"));
+  EXPECT_TRUE(requested.empty());
+  ProjectIterator besideNest(new NestIterator(leaf(), std::string("n")),
+                             AttributeNameVec{"m"});
+  EXPECT_TRUE(first(&besideNest, "m").empty());
+  EXPECT_EQ((AttributeNameVec{"m", ":id", ":time"}), requested);
+
+  // No child to push to
+  ProjectIterator orphan(nullptr, AttributeNameVec{"a"});
+}
+
+TEST(ProjectIterator, FilterSetAfterWrapping) {
+  // Only fetches the requested columns
+  auto* filter = new FilterIterator(new FutureIterator<ItemOptimized>(
+      [](const AttributeNameVec* columns) {
+        unordered_map_t row;
+        for (const auto& kv : {std::make_pair("a", 1L),
+                               std::make_pair("b", 2L)}) {
+          if (columns == nullptr || std::find(columns->begin(), columns->end(),
+                                              kv.first) != columns->end()) {
+            row.emplace(kv.first, kv.second);
+          }
+        }
+        return folly::makeFuture(std::vector<ItemOptimized>{{1, 0, row}});
+      }));
+  ProjectIterator it(filter, AttributeNameVec{"a"});
+  filter->setFilter({"b"}, {"0"}, FilterType::GT);
+  it.prepare();
+  ASSERT_TRUE(it.next());
+  EXPECT_EQ(dynamic(1L), it.value().at("a"));
+  EXPECT_FALSE(it.next());
+}
+
 int main(int argc, char* argv[]) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
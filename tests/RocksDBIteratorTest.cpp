@@ -10,7 +10,12 @@
 #include <gtest/gtest.h>
 #include <memory>
 
+#include "iterlib/CountIterator.h"
+#include "iterlib/FilterIterator.h"
 #include "iterlib/LimitIterator.h"
+#include "iterlib/ProjectIterator.h"
+#include "iterlib/RandomIterator.h"
+#include "iterlib/ReverseIterator.h"
 #include "rocksdb/comparator.h"
 #include "rocksdb/db.h"
 #include "rocksdb/options.h"
@@ -81,6 +86,9 @@ TEST_F(RocksDBIteratorTest, Simple) {
   auto iter = folly::make_unique<iterlib::RocksDBIterator>(riter);
   iter->prepare();
   EXPECT_TRUE(iter->next());
+  // Pinned slices are used in place
+  EXPECT_EQ(riter->value().data(),
+            iter->value().get<folly::StringPiece>().data());
   std::vector<std::pair<Item, Item>> expected{{
     {Item(P("c")), Item(P("3"))},
     {Item(P("b")), Item(P("2"))},
@@ -105,6 +113,27 @@ TEST_F(RocksDBIteratorTest, Simple) {
   }
 }
 
+TEST_F(RocksDBIteratorTest, RowsOutliveSlices) {
+  for (auto key : {"a", "b", "c"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  // Without pin_data slices are only valid until the iterator moves
+  iterlib::RocksDBIterator iter(getDB(), getDB()->DefaultColumnFamily(),
+                                ReadOptions());
+  EXPECT_TRUE(iter.stableValues());
+  iter.prepare();
+  std::vector<const Item*> values;
+  while (iter.next()) {
+    values.push_back(&iter.value());
+  }
+  for (auto key : {"a", "b", "c"}) {
+    ASSERT_OK(Put(key, "overwritten"));
+  }
+  ASSERT_EQ(3, values.size());
+  EXPECT_EQ("c", values[0]->get<folly::StringPiece>().str());
+  EXPECT_EQ("a", values[2]->get<folly::StringPiece>().str());
+}
+
 TEST_F(RocksDBIteratorTest, Composed) {
   ASSERT_OK(Put("a", "1"));
   ASSERT_OK(Put("b", "2"));
@@ -142,6 +171,473 @@ TEST_F(RocksDBIteratorTest, Composed) {
   }
 }
 
+TEST_F(RocksDBIteratorTest, CountRemaining) {
+  ASSERT_OK(Put("a", "1"));
+  ASSERT_OK(Put("b", "2"));
+  ASSERT_OK(Put("c", "3"));
+  ASSERT_OK(Put("d", "4"));
+  ASSERT_OK(Put("e", "5"));
+  ReadOptions ro;
+  ro.pin_data = true;
+  auto riter = getDB()->NewIterator(ro);
+  riter->SeekToFirst();
+  std::unique_ptr<iterlib::Iterator> iter =
+      folly::make_unique<iterlib::RocksDBIterator>(riter);
+  iter->prepare();
+  EXPECT_TRUE(iter->next());
+  EXPECT_EQ(Item(P("e")), iter->key());
+  EXPECT_EQ(2, iter->countRemaining(2));
+  EXPECT_TRUE(iter->next());
+  EXPECT_EQ(Item(P("b")), iter->key());
+  EXPECT_EQ(1, iter->countRemaining());
+  EXPECT_FALSE(iter->next());
+}
+
+TEST_F(RocksDBIteratorTest, EstimateRemaining) {
+  const std::string value(100, 'v');
+  for (int i = 0; i < 1000; i++) {
+    // Fixed width keys, so they sort numerically
+    ASSERT_OK(Put(std::to_string(10000 + i), value));
+  }
+  // Table properties are exact, memtable stats depend on the version
+  ASSERT_OK(getDB()->Flush(FlushOptions()));
+  ReadOptions ro;
+  ro.pin_data = true;
+  auto riter = getDB()->NewIterator(ro);
+  riter->Seek("10749");
+  auto inner = folly::make_unique<iterlib::RocksDBIterator>(riter);
+  // Reverse comparator: [10749, 10249) holds 10749 down to 10250
+  inner->setRange(getDB(), getDB()->DefaultColumnFamily(), "10749", "10249");
+  auto iter = folly::make_unique<iterlib::CountIterator>(
+      inner.release(), iterlib::CountIterator::kNoCap,
+      iterlib::CountMode::ESTIMATE);
+  iter->prepare();
+  EXPECT_TRUE(iter->next());
+  EXPECT_TRUE(iter->estimated());
+  // Sizes are approximated per block, only the magnitude is reliable
+  EXPECT_GE(iter->value().get<int64_t>(), 250);
+  EXPECT_LE(iter->value().get<int64_t>(), 1000);
+  EXPECT_FALSE(iter->next());
+}
+
+namespace {
+
+// Keys are "e" followed by a big endian timestamp, so with the reverse
+// comparator the newest rows come first
+std::string timeKey(int64_t ts) {
+  std::string key = "e";
+  for (int i = 7; i >= 0; i--) {
+    key.push_back(static_cast<char>((ts >> (i * 8)) & 0xff));
+  }
+  return key;
+}
+
+// Exposes the timestamp in the key as :time and counts the rows read
+class TimeRocksDBIterator : public iterlib::RocksDBIterator {
+ public:
+  using iterlib::RocksDBIterator::RocksDBIterator;
+
+  size_t rowsRead = 0;
+
+ protected:
+  bool doNext() override {
+    if (!iterlib::RocksDBIterator::doNext()) {
+      return false;
+    }
+    rowsRead++;
+    const auto key = iter_->key();
+    int64_t ts = 0;
+    for (size_t i = 1; i < key.size(); i++) {
+      ts = (ts << 8) | static_cast<uint8_t>(key[i]);
+    }
+    values_.back() = Item(iterlib::variant::ordered_map_t{{":time", ts}});
+    return true;
+  }
+};
+
+}
+
+TEST_F(RocksDBIteratorTest, PushDownTimeRange) {
+  for (int64_t ts = 1; ts <= 100; ts++) {
+    ASSERT_OK(Put(timeKey(ts), "v"));
+  }
+  auto inner = folly::make_unique<TimeRocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  // Descending keys: [min, max] is [timeKey(max), timeKey(min - 1))
+  inner->setKeyRangeEncoder(iterlib::kTimeKey, [](int64_t min, int64_t max) {
+    return std::make_pair(timeKey(max), timeKey(min - 1));
+  });
+  auto* scan = inner.get();
+  auto iter = folly::make_unique<iterlib::FilterIterator>(inner.release());
+  iter->setFilter({iterlib::kTimeKey}, {"90"}, iterlib::FilterType::GT);
+  iter->addFilter({iterlib::kTimeKey}, {"95"}, iterlib::FilterType::LE);
+  iter->prepare();
+  std::vector<int64_t> actual;
+  while (iter->next()) {
+    actual.push_back(iter->value().ts());
+  }
+  EXPECT_EQ((std::vector<int64_t>{95, 94, 93, 92, 91}), actual);
+  EXPECT_EQ(5, scan->rowsRead);
+}
+
+TEST_F(RocksDBIteratorTest, PushDownEmptyRange) {
+  for (int64_t ts = 1; ts <= 10; ts++) {
+    ASSERT_OK(Put(timeKey(ts), "v"));
+  }
+  auto inner = folly::make_unique<TimeRocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  inner->setKeyRangeEncoder(iterlib::kTimeKey, [](int64_t min, int64_t max) {
+    return std::make_pair(timeKey(max), timeKey(min - 1));
+  });
+  EXPECT_FALSE(inner->pushDownRange(iterlib::kIdKey, 1, 2));
+  EXPECT_TRUE(inner->pushDownRange(iterlib::kTimeKey, 5, 4));
+  inner->prepare();
+  EXPECT_FALSE(inner->next());
+  EXPECT_EQ(0, inner->rowsRead);
+}
+
+TEST_F(RocksDBIteratorTest, EstimateRemainingFromBounds) {
+  for (int64_t ts = 1; ts <= 100; ts++) {
+    ASSERT_OK(Put(timeKey(ts), std::string(100, 'v')));
+  }
+  ASSERT_OK(getDB()->Flush(FlushOptions()));
+  // The whole column family
+  iterlib::RocksDBIterator all(getDB(), getDB()->DefaultColumnFamily(),
+                               ReadOptions());
+  all.prepare();
+  EXPECT_GE(all.estimateRemaining(), 50);
+  EXPECT_LE(all.estimateRemaining(), 200);
+
+  // Only an upper bound, [timeKey(100), timeKey(50)) holds 51 to 100
+  iterlib::RocksDBIterator newest(getDB(), getDB()->DefaultColumnFamily(),
+                                  ReadOptions());
+  newest.setKeyRangeEncoder(iterlib::kTimeKey, [](int64_t min, int64_t) {
+    return std::make_pair(std::string(), timeKey(min - 1));
+  });
+  ASSERT_TRUE(newest.pushDownRange(iterlib::kTimeKey, 51, 1000));
+  newest.prepare();
+  EXPECT_GE(newest.estimateRemaining(), 25);
+  EXPECT_LE(newest.estimateRemaining(), 100);
+
+  // A caller positioned iterator doesn't know where its scan ends
+  auto riter = getDB()->NewIterator(ReadOptions());
+  riter->SeekToFirst();
+  iterlib::RocksDBIterator positioned(riter);
+  positioned.prepare();
+  EXPECT_EQ(-1, positioned.estimateRemaining());
+}
+
+TEST_F(RocksDBIteratorTest, DecodeRequiredColumns) {
+  ASSERT_OK(Put("a", "x=1;y=2;z=3"));
+  ASSERT_OK(Put("b", "x=4;y=5;z=6"));
+  size_t decoded = 0;
+  auto inner = folly::make_unique<iterlib::RocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  // Decodes "name=value;..." blobs, skipping columns that aren't needed
+  inner->setValueDecoder([&decoded](folly::StringPiece value,
+                                    const iterlib::AttributeNameVec* columns) {
+    iterlib::variant::unordered_map_t row;
+    std::vector<folly::StringPiece> fields;
+    folly::split(';', value, fields);
+    for (const auto& field : fields) {
+      auto name = field.subpiece(0, field.find('='));
+      if (columns != nullptr &&
+          std::find(columns->begin(), columns->end(), name) ==
+              columns->end()) {
+        continue;
+      }
+      decoded++;
+      row[name.str()] = folly::to<int64_t>(field.subpiece(name.size() + 1));
+    }
+    return Item(row);
+  });
+
+  iterlib::ProjectIterator iter(inner.release(), {"y"});
+  iter.prepare();
+  std::vector<int64_t> actual;
+  while (iter.next()) {
+    actual.push_back(iter.value().at("y").get<int64_t>());
+  }
+  // Reverse comparator
+  EXPECT_EQ((std::vector<int64_t>{5, 2}), actual);
+  EXPECT_EQ(2, decoded);
+}
+
+TEST_F(RocksDBIteratorTest, DecodeBinary) {
+  using iterlib::variant::unordered_map_t;
+  ASSERT_OK(Put("a", iterlib::dynamic(unordered_map_t{
+                         {"x", 1L}, {"y", std::string("one")}})
+                         .toBinary()));
+  ASSERT_OK(Put("b", iterlib::dynamic(unordered_map_t{
+                         {"x", 2L}, {"y", std::string("two")}})
+                         .toBinary()));
+  auto inner = folly::make_unique<iterlib::RocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  inner->setValueDecoder(&iterlib::RocksDBIterator::decodeBinary);
+
+  iterlib::ProjectIterator iter(inner.release(), {"y"});
+  iter.prepare();
+  std::vector<std::string> actual;
+  while (iter.next()) {
+    EXPECT_EQ(1, iter.value().size());
+    actual.push_back(iter.value().at("y").toString());
+  }
+  // Reverse comparator
+  EXPECT_EQ((std::vector<std::string>{"two", "one"}), actual);
+}
+
+TEST_F(RocksDBIteratorTest, ResumeFromCursor) {
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  auto newIterator = [this]() {
+    return folly::make_unique<iterlib::RocksDBIterator>(
+        getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  };
+
+  iterlib::dynamic cursor;
+  auto first = newIterator();
+  first->prepare();
+  ASSERT_TRUE(first->next());
+  ASSERT_TRUE(first->next());
+  EXPECT_EQ(Item(P("d")), first->key());
+  ASSERT_TRUE(first->saveCursor(&cursor));
+
+  // Resumes after "d", which has been deleted since
+  ASSERT_OK(getDB()->Delete(WriteOptions(), "d"));
+  auto second = newIterator();
+  ASSERT_TRUE(second->restoreCursor(cursor));
+  second->prepare();
+  std::vector<std::string> actual;
+  while (second->next()) {
+    actual.push_back(second->key().get<folly::StringPiece>().str());
+  }
+  EXPECT_EQ((std::vector<std::string>{"c", "b", "a"}), actual);
+  ASSERT_TRUE(second->saveCursor(&cursor));
+
+  auto third = newIterator();
+  ASSERT_TRUE(third->restoreCursor(cursor));
+  third->prepare();
+  EXPECT_FALSE(third->next());
+}
+
+TEST_F(RocksDBIteratorTest, ResaveBeforeFirstRow) {
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  auto newIterator = [this]() {
+    return folly::make_unique<iterlib::RocksDBIterator>(
+        getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  };
+  // Restores cursor, saves it again before reading and returns the rows
+  // a scan resumed from that cursor reads
+  auto hop = [&](iterlib::dynamic* cursor) {
+    auto resumed = newIterator();
+    EXPECT_TRUE(resumed->restoreCursor(*cursor));
+    resumed->prepare();
+    EXPECT_TRUE(resumed->saveCursor(cursor));
+    auto last = newIterator();
+    EXPECT_TRUE(last->restoreCursor(*cursor));
+    last->prepare();
+    std::vector<std::string> keys;
+    while (last->next()) {
+      keys.push_back(last->key().get<folly::StringPiece>().str());
+    }
+    return keys;
+  };
+
+  auto first = newIterator();
+  first->prepare();
+  ASSERT_TRUE(first->next());
+  ASSERT_TRUE(first->next());
+  iterlib::dynamic rewind;
+  iterlib::dynamic after;
+  ASSERT_TRUE(first->saveCursor(&rewind, true));
+  ASSERT_TRUE(first->saveCursor(&after));
+  EXPECT_EQ((std::vector<std::string>{"d", "c", "b", "a"}), hop(&rewind));
+
+  // The resume key is gone, the scan still resumes after it
+  ASSERT_OK(getDB()->Delete(WriteOptions(), "d"));
+  EXPECT_EQ((std::vector<std::string>{"c", "b", "a"}), hop(&after));
+}
+
+TEST_F(RocksDBIteratorTest, ReverseScan) {
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  auto inner = folly::make_unique<iterlib::RocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  auto* rocks = inner.get();
+  iterlib::ReverseIterator iter(inner.release());
+  iter.prepare();
+  std::vector<std::string> actual;
+  ASSERT_TRUE(iter.next());
+  // Streams from the rocksdb iterator instead of loading every row
+  EXPECT_EQ(&rocks->value(), &iter.value());
+  actual.push_back(iter.key().get<folly::StringPiece>().str());
+  ASSERT_TRUE(iter.skip(2));
+  actual.push_back(iter.key().get<folly::StringPiece>().str());
+  while (iter.next()) {
+    actual.push_back(iter.key().get<folly::StringPiece>().str());
+  }
+  // Reverse comparator, so forward order is e..a
+  EXPECT_EQ((std::vector<std::string>{"a", "c", "d", "e"}), actual);
+  EXPECT_TRUE(iter.done());
+}
+
+TEST_F(RocksDBIteratorTest, SkipDecodesOnlyLastRow) {
+  for (auto key : {"a", "b", "c", "d", "e"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  size_t decoded = 0;
+  auto inner = folly::make_unique<iterlib::RocksDBIterator>(
+      getDB(), getDB()->DefaultColumnFamily(), ReadOptions());
+  inner->setValueDecoder([&decoded](folly::StringPiece value,
+                                    const iterlib::AttributeNameVec*) {
+    decoded++;
+    return Item(value.str());
+  });
+
+  // Skips the offset and returns the next two rows
+  iterlib::LimitIterator iter(inner.release(), 2, 2);
+  iter.prepare();
+  std::vector<std::string> actual;
+  while (iter.next()) {
+    actual.push_back(iter.value().getRef<std::string>());
+  }
+  // Reverse comparator
+  EXPECT_EQ((std::vector<std::string>{"c", "b"}), actual);
+  EXPECT_EQ(2, decoded);
+}
+
+TEST_F(RocksDBIteratorTest, RandomSeekSample) {
+  for (char first = 'a'; first <= 'z'; first++) {
+    for (char second = 'a'; second <= 'z'; second++) {
+      const std::string key{first, second};
+      ASSERT_OK(Put(key, key));
+    }
+  }
+  const int kSamples = 2600;
+  iterlib::RandomIterator iter(
+      new iterlib::RocksDBIterator(getDB(), getDB()->DefaultColumnFamily(),
+                                   ReadOptions()),
+      kSamples, iterlib::RandomIterator::Mode::RANDOM_SEEK);
+  iter.prepare();
+  std::map<char, int> counts;
+  int samples = 0;
+  while (iter.next()) {
+    // Values hold the keys, key() isn't sampled
+    const auto key = iter.value().get<folly::StringPiece>().str();
+    ASSERT_EQ(2, key.size());
+    counts[key[0]]++;
+    samples++;
+  }
+  // Sampled with replacement, about 100 rows per first letter
+  EXPECT_EQ(kSamples, samples);
+  EXPECT_EQ(26, counts.size());
+  for (const auto& count : counts) {
+    EXPECT_GT(count.second, 50) << count.first;
+    EXPECT_LT(count.second, 150) << count.first;
+  }
+}
+
+TEST_F(RocksDBIteratorTest, RandomSeekStaysInRange) {
+  for (char first = 'a'; first <= 'z'; first++) {
+    for (char second = 'a'; second <= 'z'; second++) {
+      const std::string key{first, second};
+      ASSERT_OK(Put(key, key));
+    }
+  }
+  auto sample = [](iterlib::Iterator* inner, int count) {
+    iterlib::RandomIterator iter(
+        inner, count, iterlib::RandomIterator::Mode::RANDOM_SEEK);
+    iter.prepare();
+    std::vector<std::string> keys;
+    while (iter.next()) {
+      keys.push_back(iter.value().get<folly::StringPiece>().str());
+    }
+    return keys;
+  };
+
+  // Reverse comparator: [mz, ma) holds mz down to mb
+  auto riter = getDB()->NewIterator(ReadOptions());
+  riter->Seek("mz");
+  auto ranged = folly::make_unique<iterlib::RocksDBIterator>(riter);
+  ranged->setRange(getDB(), getDB()->DefaultColumnFamily(), "mz", "ma");
+  const auto keys = sample(ranged.release(), 200);
+  EXPECT_EQ(200, keys.size());
+  for (const auto& key : keys) {
+    EXPECT_EQ('m', key[0]) << key;
+    EXPECT_NE("ma", key);
+  }
+
+  // Without a range the whole scan is sampled, from where the caller
+  // positioned it
+  riter = getDB()->NewIterator(ReadOptions());
+  riter->Seek("cz");
+  const auto all = sample(new iterlib::RocksDBIterator(riter), 1000);
+  EXPECT_EQ(3 * 26, all.size());
+  for (const auto& key : all) {
+    EXPECT_LE(key[0], 'c') << key;
+  }
+}
+
+TEST_F(RocksDBIteratorTest, ResetSeeksBack) {
+  for (auto key : {"a", "b", "c", "d"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  // Resumes after "c", reverse comparator so "b" and "a" are left
+  iterlib::dynamic cursor =
+      iterlib::variant::vector_dynamic_t{std::string("c"), int64_t(1)};
+  iterlib::RocksDBIterator iter(getDB(), getDB()->DefaultColumnFamily(),
+                                ReadOptions());
+  ASSERT_TRUE(iter.restoreCursor(cursor));
+  iter.prepare();
+  for (int pass = 0; pass < 2; pass++) {
+    std::vector<std::string> actual;
+    while (iter.next()) {
+      actual.push_back(iter.key().get<folly::StringPiece>().str());
+    }
+    EXPECT_EQ((std::vector<std::string>{"b", "a"}), actual);
+    ASSERT_TRUE(iter.reset());
+  }
+  EXPECT_FALSE(iter.cacheable());
+}
+
+TEST_F(RocksDBIteratorTest, ResetReusesRows) {
+  for (auto key : {"a", "b", "c", "d"}) {
+    ASSERT_OK(Put(key, key));
+  }
+  size_t decoded = 0;
+  iterlib::RocksDBIterator iter(getDB(), getDB()->DefaultColumnFamily(),
+                                ReadOptions());
+  iter.setValueDecoder([&decoded](folly::StringPiece value,
+                                  const iterlib::AttributeNameVec*) {
+    decoded++;
+    return Item(value);
+  });
+  iter.prepare();
+  // Rows stepped over are built the first time they are returned
+  ASSERT_TRUE(iter.skip(2));
+  EXPECT_EQ(1, decoded);
+  ASSERT_TRUE(iter.reset());
+  std::vector<const Item*> first;
+  while (iter.next()) {
+    first.push_back(&iter.value());
+  }
+  EXPECT_EQ(4, first.size());
+  EXPECT_EQ(4, decoded);
+  for (int pass = 0; pass < 10; pass++) {
+    ASSERT_TRUE(iter.reset());
+    std::vector<const Item*> again;
+    while (iter.next()) {
+      again.push_back(&iter.value());
+    }
+    EXPECT_EQ(first, again);
+  }
+  EXPECT_EQ(4, decoded);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,69 @@
+//  Copyright (c) 2016, Facebook, Inc.  All rights reserved.
+#include <gtest/gtest.h>
+
+#include "ExpectIterator.h"
+
+#include "iterlib/SpoolIterator.h"
+
+using namespace iterlib;
+
+TEST(SpoolIterator, SharesOneScan) {
+  int fetches = 0;
+  auto spool = Spool::create(countingSource(&fetches));
+  auto first = spool->newCursor();
+  auto second = spool->newCursor();
+  EXPECT_FALSE(first->cacheable());
+
+  ExpectIterator(first.get(), kRows);
+  EXPECT_EQ(kRows.size(), spool->buffered());
+  ExpectIterator(second.get(), kRows);
+  EXPECT_EQ(1, fetches);
+  EXPECT_EQ(0, first->estimateRemaining());
+}
+
+TEST(SpoolIterator, LockStepCursorsTrim) {
+  auto spool = Spool::create(new UnstableIterator(
+      new FutureIterator<ItemOptimized>(folly::makeFuture(kRows))));
+  auto first = spool->newCursor();
+  auto second = spool->newCursor();
+  prepare(first.get());
+  prepare(second.get());
+
+  for (const auto& row : kRows) {
+    ASSERT_TRUE(first->next());
+    ASSERT_TRUE(second->next());
+    EXPECT_EQ(row.value(), first->value().value());
+    EXPECT_EQ(row.value(), second->value().value());
+    EXPECT_LE(spool->buffered(), 1);
+  }
+  EXPECT_THROW(spool->newCursor(), std::logic_error);
+
+  // Rows a cursor still points at are kept until it moves on
+  second.reset();
+  EXPECT_EQ(1, spool->buffered());
+  EXPECT_EQ(kRows.back().value(), first->value().value());
+  EXPECT_FALSE(first->next());
+}
+
+TEST(SpoolIterator, MaterializedCursorsStartLate) {
+  int fetches = 0;
+  auto spool = Spool::create(countingSource(&fetches),
+                             Spool::Mode::MATERIALIZE);
+  auto first = spool->newCursor();
+  EXPECT_TRUE(first->cacheable());
+  EXPECT_TRUE(first->stableValues());
+  ExpectIterator(first.get(), kRows);
+
+  auto second = spool->newCursor();
+  ExpectIterator(second.get(), kRows);
+  first.reset();
+  auto third = spool->newCursor();
+  ExpectIterator(third.get(), kRows);
+  EXPECT_EQ(1, fetches);
+  EXPECT_EQ(kRows.size(), spool->buffered());
+}
+
+int main(int argc, char* argv[]) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}